@@ -0,0 +1,87 @@
+#include "Audio.h"
+#include <cmath>
+#include <cstring>
+
+#define PHASE_SHIFT 25 // 32 bits of phase - 7 bits of sample index
+
+void AudioMixer::setOutput(int rate, int channels)
+{
+	hostRate = rate;
+	hostChannels = channels;
+}
+
+void AudioMixer::update(const Chip8& chip8)
+{
+	for (int w = 0; w < AUDIO_PATTERN_WORDS; w++)
+	{
+		const unsigned char* bytes = &chip8.audioPattern[w * 4];
+		uint32_t word = (uint32_t)bytes[0] << 24 | (uint32_t)bytes[1] << 16 | (uint32_t)bytes[2] << 8 | bytes[3];
+		pattern[w].store(word, std::memory_order_relaxed);
+	}
+
+	// XO-CHIP playback rate: 4000*2^((pitch-64)/48) samples of the pattern per second
+	double rate = 4000.0 * std::pow(2.0, (chip8.pitch - 64) / 48.0);
+	step.store((uint32_t)(rate / hostRate * (1u << PHASE_SHIFT)), std::memory_order_relaxed);
+
+	playing.store(chip8.audioPatternLoaded && chip8.sound_timer > 0, std::memory_order_release);
+}
+
+void AudioMixer::refreshTable()
+{
+	bool changed = false;
+	for (int w = 0; w < AUDIO_PATTERN_WORDS; w++)
+	{
+		uint32_t word = pattern[w].load(std::memory_order_relaxed);
+		changed |= word != tablePattern[w];
+		tablePattern[w] = word;
+	}
+	if (!changed)
+		return;
+
+	// Expand each bit of the pattern to a sample, MSB first
+	for (int i = 0; i < AUDIO_PATTERN_BITS; i++)
+	{
+		uint32_t bit = (tablePattern[i >> 5] >> (31 - (i & 31))) & 1;
+		table[i] = bit ? AUDIO_AMPLITUDE : -AUDIO_AMPLITUDE;
+	}
+}
+
+void AudioMixer::mix(int16_t* stream, int frames)
+{
+	if (!playing.load(std::memory_order_acquire))
+	{
+		memset(stream, 0, sizeof(int16_t) * frames * hostChannels);
+		return;
+	}
+
+	refreshTable();
+	const uint32_t inc = step.load(std::memory_order_relaxed);
+
+	int16_t block[AUDIO_BLOCK];
+	while (frames > 0)
+	{
+		int n = frames < AUDIO_BLOCK ? frames : AUDIO_BLOCK;
+
+		// Resample: every sample only depends on its own phase, the loop has no carried dependency
+		for (int i = 0; i < n; i++)
+			block[i] = table[(phase + (uint32_t)i * inc) >> PHASE_SHIFT];
+		phase += (uint32_t)n * inc;
+
+		// Copy the mono block to every channel of the interleaved stream
+		if (hostChannels == 1)
+			memcpy(stream, block, sizeof(int16_t) * n);
+		else if (hostChannels == 2)
+			for (int i = 0; i < n; i++)
+			{
+				stream[2 * i] = block[i];
+				stream[2 * i + 1] = block[i];
+			}
+		else
+			for (int i = 0; i < n; i++)
+				for (int c = 0; c < hostChannels; c++)
+					stream[i * hostChannels + c] = block[i];
+
+		stream += n * hostChannels;
+		frames -= n;
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "Chip8.h"
+
+#define AUDIO_PATTERN_BITS (AUDIO_PATTERN_LENGTH * 8)
+#define AUDIO_PATTERN_WORDS (AUDIO_PATTERN_LENGTH / 4)
+#define AUDIO_BLOCK 64 // Samples resampled per inner loop
+#define AUDIO_AMPLITUDE 6000
+
+/*
+ * Plays the XO-CHIP audio pattern buffer on the host audio device.
+ * The emulator thread publishes the pattern and pitch of a Chip8 with update(),
+ * the audio thread resamples them to the host rate with mix().
+ * mix() never allocates nor locks, so it is safe to call from the audio callback.
+*/
+class AudioMixer
+{
+public:
+	/*
+	 * Set the format of the host device. Samples are signed 16 bits, interleaved.
+	*/
+	void setOutput(int rate, int channels);
+
+	/*
+	 * Publish the current audio state of the emulator (emulator thread)
+	*/
+	void update(const Chip8& chip8);
+
+	/*
+	 * Fill the stream with the given amount of frames (audio thread)
+	*/
+	void mix(int16_t* stream, int frames);
+
+	int channels() const { return hostChannels; }
+
+private:
+	/*
+	 * Shared between both threads
+	*/
+	std::atomic<uint32_t> pattern[AUDIO_PATTERN_WORDS] = {};
+	std::atomic<uint32_t> step{ 0 }; // Phase increment per host sample
+	std::atomic<bool> playing{ false };
+
+	int hostRate = 44100;
+	int hostChannels = 2;
+
+	/*
+	 * Audio thread only.
+	 * The phase is a 32 bit fixed point position in the pattern, the upper 7 bits are the sample index.
+	 * The pattern is expanded once into a table of samples so the resampling loop has no bit twiddling
+	 * nor branches and can be vectorized.
+	*/
+	uint32_t phase = 0;
+	uint32_t tablePattern[AUDIO_PATTERN_WORDS] = {};
+	int16_t table[AUDIO_PATTERN_BITS] = {};
+
+	void refreshTable();
+};
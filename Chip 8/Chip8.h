@@ -1,42 +1,68 @@
 #pragma once
 
-#include <fstream>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include "Hash.h"
+#include "Platform.h"
+#include "RomDatabase.h"
+#include "RomImage.h"
 
-#define WIDTH 64
-#define HEIGHT 32
-#define MEM 4096
+#define LORES_WIDTH 64
+#define LORES_HEIGHT 32
+#define HIRES_WIDTH 128 // SUPER-CHIP high resolution mode
+#define HIRES_HEIGHT 64
+#define ROW_WORDS (HIRES_WIDTH / 64) // 64 bit words per row of the framebuffer
+#define PLANES 2 // XO-CHIP bitplanes
 #define V_LENGTH 16
 #define STACK_LENGTH 16
 #define KEY_LENGTH 16
-#define TOTAL_PIXELS WIDTH*HEIGHT
+#define RPL_LENGTH 16
+#define AUDIO_PATTERN_LENGTH 16
+#define FONT_ADDR 0x000
+#define BIGFONT_ADDR 0x050
+#define CACHE_LINE 64
+#define RANDOM_SEED 0x2545F491 // First state of the random number generator of CXNN
 
-class Chip8
-{
-public:
-	bool drawFlag = false; // Flag to see if it's needed to draw on the screen
-
-	int playSound = 0;
+class Chip8;
+class RomPack;
 
-	unsigned short opcode; // Operation Code -- 2 bytes
+/*
+ * What the interpreter does on an opcode the platform doesn't have
+*/
+enum class UnknownOpcodePolicy : unsigned char
+{
+	Halt, // Stop the interpreter like 00FD, with halted set. The program usually ran into data.
+	Skip, // Go on with the next instruction
+	Trap // Call unknownOpcodeTrap, which decides what happens next. Halt if there's none.
+};
 
-	/*
-	 * Memory map
-	 * 0x000-0x1FF - Chip 8 interpreter (contains font set in emu)
-	 * 0x050-0x0A0 - Used for the built in 4x5 pixel font set (0-F)
-	 * 0x200-0xFFF - Program ROM and work RAM
-	*/
-	unsigned char memory[MEM];
+/*
+ * Errors counted per instance, the log only writes a few of them (see Log.h)
+*/
+struct Chip8Errors
+{
+	uint32_t unknownOpcodes;
+};
 
+/*
+ * State of the machine.
+ * Trivially copyable, so an instance is reset or copied with a single memcpy (see Chip8::reset and Chip8Pool).
+ * Cache line aligned and ordered by use: the first line holds everything an ordinary instruction touches
+ * (registers, timers, the interpreter and the display mode), the second one the stack, the keys and the
+ * RPL flags. The memory page table and the framebuffer come last.
+*/
+struct alignas(CACHE_LINE) Chip8State
+{
 	unsigned char V[V_LENGTH]; // 1 byte per register -- V0 -> VE
 
 	unsigned short I; // Index register
 	unsigned short pc; // Program Counter
-
-	/*
-	 * Graphics for the Chip 8. It has a total of 2048 pixels (64*32).
-	 * The array will hold the state of the pixel (0 or 1)
-	*/
-	unsigned char gfx[TOTAL_PIXELS];
+	unsigned short sp; // To remember which level is used, a stack pointer is necessary. Wraps around within the 16 levels.
+	unsigned short opcode; // Operation Code -- 2 bytes
 
 	/*
 	 * Two timer register that count at 60 Hz
@@ -44,12 +70,30 @@ public:
 	unsigned char delay_timer;
 	unsigned char sound_timer;
 
+	bool drawFlag = false; // Flag to see if it's needed to draw on the screen
+
+	bool exited = false; // The program executed 00FD (SUPER-CHIP) or was halted, the interpreter is stopped
+
+	int playSound = 0;
+
+	/*
+	 * Interpreter specialized for the platform, selected by initialize()
+	*/
+	void (*cycleFn)(Chip8&) = nullptr;
+	void (*runFn)(Chip8&, int) = nullptr;
+
+	unsigned char planes; // Bitmask of the planes affected by drawing, clearing and scrolling (FN01)
+	bool hires; // High resolution mode enabled with 00FF (SUPER-CHIP)
+	int width; // Current resolution
+	int height;
+
+	Platform platform = Platform::Modern;
+
 	/*
 	 * Implement a stack to remember the current location before a jump is performed.
 	 * When a jump or call a subroutine is performed, store the pc in the stack before proceeding
 	*/
 	unsigned short stack[STACK_LENGTH]; // 16 levels of stack
-	unsigned short sp; // To remember which level is used, a stack pointer is necessary
 
 	/*
 	 * HEX based keyboard -> 0x0 - 0xF
@@ -57,9 +101,138 @@ public:
 	unsigned char key[KEY_LENGTH];
 
 	/*
-	 * Chip 8 fontset
+	 * HP48 RPL user flags, saved and restored with FX75 and FX85 (SUPER-CHIP)
+	*/
+	unsigned char rpl[RPL_LENGTH];
+
+	/*
+	 * XO-CHIP audio. A 16 byte (128 samples) 1-bit pattern loaded with F002,
+	 * played in a loop while the sound timer is active at 4000*2^((pitch-64)/48) Hz.
+	*/
+	unsigned char audioPattern[AUDIO_PATTERN_LENGTH];
+	unsigned char pitch; // Set with FX3A, 64 means 4000 Hz
+	bool audioPatternLoaded = false; // The ROM has used F002, otherwise the default beep is played
+
+	/*
+	 * Random number generator of CXNN (xorshift32). Each instance has its own, seeded the same way by
+	 * initialize(), so a run only depends on the ROM and the keys and can be compared bit for bit.
+	*/
+	uint32_t random = RANDOM_SEED;
+
+	/*
+	 * Identification of the loaded ROM
+	*/
+	uint64_t romHash = 0;
+	const RomInfo* romInfo = &findRom(0);
+
+	/*
+	 * Errors of the program and what to do about them, kept by initialize()
+	*/
+	UnknownOpcodePolicy unknownOpcodePolicy = UnknownOpcodePolicy::Halt;
+	void (*unknownOpcodeTrap)(Chip8&) = nullptr; // c.opcode at c.pc, the trap sets the pc to go on
+	bool halted = false; // Stopped by an unknown opcode
+	Chip8Errors errors = {};
+
+	uint64_t idleCycles = 0; // Cycles skipped while the program waited in place (see Interpreter::run)
+
+	/*
+	 * Memory map
+	 * 0x000-0x1FF - Chip 8 interpreter (contains font set in emu)
+	 * 0x000-0x04F - Used for the built in 4x5 pixel font set (0-F)
+	 * 0x050-0x0EF - Used for the built in 8x10 pixel SUPER-CHIP font set (0-F)
+	 * 0x200-0xFFF - Program ROM and work RAM (up to 0xFFFF in XO-CHIP)
+	 *
+	 * The memory is split in pages of 256 bytes. Every page starts pointing to the shared image of the ROM
+	 * (see RomImage.h) and is copied to a private page the first time it is written, so instances running
+	 * the same ROM only hold the few pages they modify.
+	 * Read with read() and write with write(), never through the page table directly.
+	 * Addresses wrap around at memSize, 4 KB or the 64 KB of XO-CHIP: I + 15 in DXYN reads from 0 past the end,
+	 * and an instance never holds pages past its memory.
+	*/
+	const RomImage* image = nullptr;
+	unsigned int memSize = 0;
+	uint64_t privatePages[MAX_PAGES / 64] = {}; // Bitmask of the pages copied from the image, this instance holds a reference
+	uint64_t writablePages[MAX_PAGES / 64] = {}; // Bitmask of the private pages not shared with a clone
+	const unsigned char* pages[MAX_PAGES]; // The first memSize / MEM_PAGE_SIZE entries are used
+
+	/*
+	 * Incremental hashes of the memory and of each plane of the framebuffer, kept up to date on every write
+	 * (see Hash.h and fingerprint())
+	*/
+	uint64_t memHash = 0;
+	uint64_t gfxHash[PLANES] = {};
+
+	/*
+	 * Graphics for the Chip 8. 64*32 pixels in low resolution and 128*64 in the SUPER-CHIP high resolution.
+	 * Each row is packed in 64 bit words, one bit per pixel and the leftmost pixel in the most significant bit,
+	 * so sprites are drawn and scrolled with shifts and whole row moves instead of pixel by pixel.
+	 * In low resolution only the first word of the first 32 rows is used.
+	 * XO-CHIP has two bitplanes, a pixel is the color index (plane1 << 1 | plane0) in a palette of 4 colors.
+	*/
+	uint64_t gfx[PLANES][HIRES_HEIGHT][ROW_WORDS];
+};
+
+static_assert(std::is_trivially_copyable_v<Chip8State>, "Chip8State is copied with memcpy");
+static_assert(sizeof(Chip8State::gfx) / sizeof(uint64_t) == GFX_WORDS, "Every framebuffer word needs a hash key");
+static_assert(offsetof(Chip8State, stack) == CACHE_LINE, "The registers must fit in the first cache line");
+static_assert(offsetof(Chip8State, audioPattern) == 2 * CACHE_LINE, "The stack, keys and RPL flags must fit in the second cache line");
+
+class Chip8 : public Chip8State
+{
+public:
+	Chip8() = default;
+	~Chip8()
+	{
+		releasePages();
+		RomImage::release(image);
+	}
+
+	// The private pages are owned by one instance, copy with reset()
+	Chip8(const Chip8&) = delete;
+	Chip8& operator=(const Chip8&) = delete;
+
+	/*
+	 * Addresses wrap around at memSize. The interpreter passes the mask of its platform, a constant there
+	 * (see Interpreter.h).
+	*/
+	unsigned char read(unsigned int addr) const { return read(addr, memSize - 1); }
+	unsigned short read16(unsigned int addr) const { return read16(addr, memSize - 1); }
+	void write(unsigned int addr, unsigned char value) { write(addr, value, memSize - 1); }
+
+	unsigned char read(unsigned int addr, unsigned int mask) const
+	{
+		addr &= mask;
+		return pages[addr >> MEM_PAGE_SHIFT][addr & MEM_PAGE_MASK];
+	}
+
+	/*
+	 * Big endian 16 bit word, with a single page lookup unless it straddles two pages
+	*/
+	unsigned short read16(unsigned int addr, unsigned int mask) const
+	{
+		addr &= mask;
+		const unsigned char* page = pages[addr >> MEM_PAGE_SHIFT];
+		unsigned int offset = addr & MEM_PAGE_MASK;
+		if (offset != MEM_PAGE_MASK)
+			return page[offset] << 8 | page[offset + 1];
+		return page[offset] << 8 | read(addr + 1, mask);
+	}
+
+	void write(unsigned int addr, unsigned char value, unsigned int mask)
+	{
+		addr &= mask;
+		unsigned int p = addr >> MEM_PAGE_SHIFT;
+		if (!(writablePages[p >> 6] & (1ull << (p & 63))))
+			makeWritable(p);
+		unsigned char& byte = const_cast<unsigned char*>(pages[p])[addr & MEM_PAGE_MASK]; // Private pages are writable
+		memHash ^= memoryKey(addr, byte) ^ memoryKey(addr, value);
+		byte = value;
+	}
+
+	/*
+	 * Chip 8 fontset, stored in the ROM images
 	*/
-	unsigned char chip8_fontset[80] =
+	static constexpr unsigned char chip8_fontset[80] =
 	{
 	  0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
 	  0x20, 0x60, 0x20, 0x20, 0x70, // 1
@@ -79,38 +252,135 @@ public:
 	  0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 	};
 
+	/*
+	 * SUPER-CHIP 8x10 fontset
+	*/
+	static constexpr unsigned char schip_bigfontset[160] =
+	{
+	  0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+	  0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+	  0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+	  0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+	  0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+	  0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+	  0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+	  0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+	  0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+	  0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+	  0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+	  0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+	  0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+	  0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+	  0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+	  0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+	};
+
 	/*
 	 * Prepare the system state, initialize all to default values of the system
+	 * and select the interpreter of the platform. The unknown opcode policy is kept.
 	*/
-	void initialize();
+	void initialize(Platform platform = Platform::Modern);
 
 	/*
-	 * Load the program into the memory
+	 * Load the program into the memory.
+	 * The ROM is looked up by hash in the ROM database, if it expects another platform
+	 * the system is initialized again for it. A platform given here wins over the database,
+	 * e.g. to run an unknown XO-CHIP ROM.
+	 * A path that doesn't open is tried as pack:rom, a ROM of a pack built with chip8-pack.
 	*/
-	bool loadProgram(const char* rom);
+	bool loadProgram(const char* rom, std::optional<Platform> forcePlatform = std::nullopt);
 
 	/*
-	 * Get the Size of a File in C++
-	 * https://www.joelverhagen.com/blog/2011/03/get-the-size-of-a-file-in-c/
+	 * Load a ROM of a pack, found by its name or by the hexadecimal hash of its image
 	*/
-	int getFileSize(const char* fileName)
-	{
-		std::ifstream file(fileName, std::ifstream::in | std::ifstream::binary);
+	bool loadProgram(const RomPack& pack, std::string_view rom, std::optional<Platform> forcePlatform = std::nullopt);
 
-		if (!file.is_open())
-			return -1;
+	/*
+	 * Load a program that is already in memory, e.g. one image shared by many instances.
+	 * The image is copied, it doesn't need to outlive the Chip8.
+	*/
+	bool loadProgram(std::span<const uint8_t> rom, std::optional<Platform> forcePlatform = std::nullopt);
 
-		file.seekg(0, std::ios::end);
-		int fileSize = (int)file.tellg();
-		file.close();
+	/*
+	 * Make this instance a copy of another state, e.g. a pristine instance with the ROM loaded.
+	 * The state is copied at once, then the private pages of the source are copied again so each instance
+	 * keeps its own.
+	*/
+	void reset(const Chip8State& pristine);
 
-		return fileSize;
-	}
+	/*
+	 * Make clone an exact copy of this instance, e.g. to branch a search from this state.
+	 * The pages written so far are shared with the clone and copied again by whichever writes them first,
+	 * so a clone costs one copy of the state whatever memory the ROM has used.
+	*/
+	void cloneInto(Chip8& clone);
+
+	/*
+	 * Clone into n instances at once, e.g. the instances of a Chip8Pool, one per input to try.
+	 * This instance can't be one of them.
+	*/
+	void fork(Chip8* clones, size_t n);
+
+	/*
+	 * Fingerprint of the whole machine state: memory, framebuffer, registers, stack, timers, display mode,
+	 * random generator, audio pattern and pitch, and whether the program exited or halted.
+	 * Equal states have equal fingerprints, so visited states can be deduplicated in a search.
+	 * The memory and the framebuffer are hashed incrementally as they are written, only the registers
+	 * are hashed here, so it costs the same whatever the state. The keys are input, not state, and are left out,
+	 * as are the outputs to the frontend (drawFlag, playSound) and the counters.
+	*/
+	uint64_t fingerprint() const;
 
 	/*
 	 * Execute an opcode.
 	 * First fetch the opcode, decode, execute it and update timers.
 	*/
-	void emulateCycle();
+	void emulateCycle()
+	{
+		cycleFn(*this);
+	}
+
+	/*
+	 * Execute several cycles, only paying the dispatch to the platform interpreter once
+	*/
+	void run(int cycles)
+	{
+		runFn(*this, cycles);
+	}
+
+	/*
+	 * Count and log the unknown opcode c.opcode at pc, then apply the policy
+	*/
+	void unknownOpcode();
+
+	/*
+	 * Color index (0-3) of the pixel at (x, y) in the current resolution
+	*/
+	int getPixel(int x, int y) const
+	{
+		int bit = 63 - (x & 63);
+		return (int)((gfx[0][y][x >> 6] >> bit) & 1) | (int)((gfx[1][y][x >> 6] >> bit) & 1) << 1;
+	}
+
+private:
+	/*
+	 * Point every page to the image, dropping the private copies. Takes over the reference of the caller.
+	*/
+	void mapImage(const RomImage* newImage);
+
+	/*
+	 * Copy another state, dropping the private pages and moving the image reference to its image
+	*/
+	void assignState(const Chip8State& source);
+
+	/*
+	 * Copy on write of a page shared with the image or with clones
+	*/
+	void makeWritable(unsigned int p);
+
+	/*
+	 * Drop the references to the private pages
+	*/
+	void releasePages();
 
 };
@@ -0,0 +1,75 @@
+#include "Chip8Pool.h"
+#include <new>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+Chip8Pool::Chip8Pool(size_t count, bool hugePages) : count(count)
+{
+	size_t size = (count ? count : 1) * sizeof(Chip8);
+
+#ifdef _WIN32
+	// Large pages need the "Lock pages in memory" privilege, fall back to normal pages without it
+	size_t large = GetLargePageMinimum();
+	if (hugePages && large)
+	{
+		arenaSize = (size + large - 1) / large * large;
+		arena = VirtualAlloc(NULL, arenaSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		huge = arena != NULL;
+	}
+	if (!arena)
+	{
+		arenaSize = size;
+		arena = VirtualAlloc(NULL, arenaSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	}
+	if (!arena)
+		throw std::bad_alloc();
+#else
+	// Round up to whole huge pages and align the arena to one, so the kernel can back all of it with them
+	arenaSize = hugePages ? (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE : size;
+	size_t mapped = hugePages ? arenaSize + HUGE_PAGE_SIZE : arenaSize;
+	void* base = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED)
+		throw std::bad_alloc();
+	arena = base;
+	if (hugePages)
+	{
+		// Unmap the unaligned head and the tail
+		size_t head = (HUGE_PAGE_SIZE - (size_t)base % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+		arena = (char*)base + head;
+		if (head)
+			munmap(base, head);
+		munmap((char*)arena + arenaSize, HUGE_PAGE_SIZE - head);
+#ifdef MADV_HUGEPAGE
+		huge = madvise(arena, arenaSize, MADV_HUGEPAGE) == 0;
+#endif
+	}
+#endif
+
+	instances = (Chip8*)arena;
+	for (size_t i = 0; i < count; i++)
+		new (&instances[i]) Chip8();
+}
+
+Chip8Pool::~Chip8Pool()
+{
+	for (size_t i = 0; i < count; i++)
+		instances[i].~Chip8();
+
+#ifdef _WIN32
+	VirtualFree(arena, 0, MEM_RELEASE);
+#else
+	munmap(arena, arenaSize);
+#endif
+}
+
+void Chip8Pool::resetAll(const Chip8State& pristine)
+{
+	for (size_t i = 0; i < count; i++)
+		instances[i].reset(pristine);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include "Chip8.h"
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/*
+ * Many Chip8 instances allocated contiguously from a single arena, for batch runs.
+ * The instances are cache line aligned and the arena is backed by 2 MB huge pages when the system
+ * allows it, so keeping thousands of instances hot doesn't cost a TLB miss per instance.
+ * Instances are usually reset from a pristine instance that has loaded the ROM:
+ *     Chip8 pristine;
+ *     pristine.initialize();
+ *     pristine.loadProgram(rom);
+ *     pool.resetAll(pristine);
+*/
+class Chip8Pool
+{
+public:
+	explicit Chip8Pool(size_t count, bool hugePages = true);
+	~Chip8Pool();
+
+	Chip8Pool(const Chip8Pool&) = delete;
+	Chip8Pool& operator=(const Chip8Pool&) = delete;
+
+	size_t size() const { return count; }
+	Chip8& operator[](size_t i) { return instances[i]; }
+	Chip8* data() { return instances; } // To fork into the whole pool with Chip8::fork
+
+	/*
+	 * Copy the pristine state into every instance
+	*/
+	void resetAll(const Chip8State& pristine);
+
+	/*
+	 * The arena is backed by huge pages (Windows large pages, or Linux transparent huge pages requested with madvise)
+	*/
+	bool hugePages() const { return huge; }
+
+private:
+	Chip8* instances = nullptr;
+	size_t count = 0;
+	void* arena = nullptr;
+	size_t arenaSize = 0;
+	bool huge = false;
+};
@@ -0,0 +1,287 @@
+#include "ControlFlow.h"
+#include "Chip8.h"
+#include "Disassembler.h"
+#include <algorithm>
+#include <cstdlib>
+
+/*
+ * Where an instruction goes next, as decoded from the ROM alone
+*/
+struct Flow
+{
+	BlockEnd kind; // Next for the instructions that don't end a block
+	unsigned int length; // Of the instruction, 0 when past the end of the ROM
+	unsigned int targets[2];
+	int targetCount;
+	uint16_t callee;
+};
+
+/*
+ * The ROM as the program sees it from 0x200, the rest of the memory reads as zeros
+*/
+class RomView
+{
+public:
+	RomView(std::span<const uint8_t> rom, Platform platform)
+		: rom(rom), end(APP_DATA + (unsigned int)rom.size()), platform(platform),
+		mask(withPlatform(platform, [](auto p) { return decltype(p)::memSize - 1; }))
+	{
+	}
+
+	// Addresses wrap around at the end of the memory of the platform
+	unsigned int wrap(unsigned int addr) const { return addr & mask; }
+
+	bool contains(unsigned int addr) const { return addr >= APP_DATA && addr < end; }
+	unsigned int byte(unsigned int addr) const { return contains(addr) ? rom[addr - APP_DATA] : 0; }
+	unsigned short opcode(unsigned int addr) const { return (unsigned short)(byte(addr) << 8 | byte(addr + 1)); }
+
+	// F000 NNNN is 4 bytes long on XO-CHIP
+	unsigned int length(unsigned int addr) const { return platform == Platform::XoChip && opcode(addr) == 0xF000 ? 4 : 2; }
+
+	Flow decode(unsigned int pc) const
+	{
+		Flow flow = { BlockEnd::Next, length(pc), { 0, 0 }, 0, 0 };
+		if (!contains(pc) || !contains(pc + flow.length - 1))
+		{
+			flow.kind = BlockEnd::OutOfRom;
+			flow.length = 0;
+			return flow;
+		}
+
+		unsigned short op = opcode(pc);
+		unsigned int nnn = op & 0x0FFF;
+		auto next = [&](BlockEnd kind, unsigned int target)
+		{
+			flow.kind = kind;
+			flow.targets[flow.targetCount++] = wrap(target);
+		};
+		if (!validOpcode(op, platform))
+		{
+			flow.kind = BlockEnd::Invalid;
+			return flow;
+		}
+
+		switch (op & 0xF000)
+		{
+		case 0x0000:
+			if ((op & 0x00FF) == 0x00EE)
+				flow.kind = BlockEnd::Return;
+			else if ((op & 0x00FF) == 0x00FD)
+				flow.kind = BlockEnd::Exit; // Valid only on SUPER-CHIP and XO-CHIP
+			else
+				next(BlockEnd::Next, pc + 2);
+			break;
+		case 0x1000:
+			if (nnn == pc)
+				flow.kind = BlockEnd::Loop;
+			else
+				next(BlockEnd::Jump, nnn);
+			break;
+		case 0x2000:
+			next(BlockEnd::Call, pc + 2);
+			flow.callee = (uint16_t)nnn;
+			break;
+		case 0x3000:
+		case 0x4000:
+		case 0x5000:
+		case 0x9000:
+		case 0xE000:
+			if ((op & 0xF000) == 0x5000 && (op & 0x000F) != 0) // 5XY2 and 5XY3 (XO-CHIP) don't skip
+			{
+				next(BlockEnd::Next, pc + 2);
+				break;
+			}
+			next(BlockEnd::Skip, pc + 2);
+			next(BlockEnd::Skip, pc + 2 + length(pc + 2));
+			break;
+		case 0xB000:
+			next(BlockEnd::Indirect, nnn); // The target for a register of 0, a jump table usually starts there
+			break;
+		default:
+			next(BlockEnd::Next, pc + flow.length);
+		}
+		return flow;
+	}
+
+private:
+	std::span<const uint8_t> rom;
+	unsigned int end;
+	Platform platform;
+	unsigned int mask;
+};
+
+const BasicBlock* ControlFlowGraph::blockAt(unsigned int addr) const
+{
+	auto it = std::lower_bound(blocks.begin(), blocks.end(), addr, [](const BasicBlock& b, unsigned int a) { return b.start < a; });
+	return it != blocks.end() && it->start == addr ? &*it : nullptr;
+}
+
+ControlFlowGraph buildControlFlow(std::span<const uint8_t> rom, Platform platform)
+{
+	ControlFlowGraph cfg;
+	cfg.platform = platform;
+	RomView view(rom, platform);
+
+	// Code wins over the other kinds, each byte used two ways is counted once however often it is marked
+	std::vector<bool> overlapped(CFG_ADDRESSES);
+	auto mark = [&](unsigned int addr, ByteKind kind)
+	{
+		addr = view.wrap(addr);
+		if (!view.contains(addr))
+			return;
+		ByteKind& byte = cfg.bytes[addr];
+		if (byte == ByteKind::Unknown)
+			byte = kind;
+		else if (byte != kind)
+		{
+			if (!overlapped[addr])
+			{
+				overlapped[addr] = true;
+				cfg.overlaps++;
+			}
+			if (kind == ByteKind::Code)
+				byte = kind;
+		}
+	};
+
+	/*
+	 * Find every reachable instruction, depth first from 0x200.
+	 * The targets of jumps, calls and skips and the instructions after them start blocks.
+	*/
+	std::vector<bool> reached(CFG_ADDRESSES), leader(CFG_ADDRESSES);
+	std::vector<unsigned int> work = { APP_DATA };
+	leader[APP_DATA] = true;
+	while (!work.empty())
+	{
+		unsigned int pc = work.back();
+		work.pop_back();
+		while (!reached[pc])
+		{
+			reached[pc] = true;
+			Flow flow = view.decode(pc);
+			if (flow.length)
+			{
+				mark(pc, ByteKind::Code);
+				for (unsigned int i = 1; i < flow.length; i++)
+					mark(pc + i, ByteKind::Operand);
+			}
+			if (flow.kind == BlockEnd::Call)
+			{
+				leader[flow.callee] = true;
+				work.push_back(flow.callee);
+			}
+			if (flow.kind != BlockEnd::Next)
+				for (int t = 0; t < flow.targetCount; t++)
+				{
+					leader[flow.targets[t]] = true;
+					work.push_back(flow.targets[t]);
+				}
+			else
+			{
+				pc = flow.targets[0]; // Straight on
+				continue;
+			}
+			break;
+		}
+	}
+
+	// FX55 and FX65 move I on some platforms
+	IndexIncrement increment = withPlatform(platform, [](auto p) { return decltype(p)::loadStoreIncrement; });
+	bool superChip = platform == Platform::SuperChip || platform == Platform::XoChip;
+
+	// Cut the code into blocks at the leaders, following the constant values of I within each block
+	for (unsigned int start = 0; start < CFG_ADDRESSES; start++)
+	{
+		if (!leader[start] || !reached[start])
+			continue;
+		BasicBlock block = { (uint16_t)start, (uint16_t)start, BlockEnd::Next, {} };
+		bool knownI = false;
+		unsigned int I = 0;
+		unsigned int pc = start;
+		while (true)
+		{
+			Flow flow = view.decode(pc);
+			if (flow.kind == BlockEnd::OutOfRom)
+			{
+				block.kind = flow.kind;
+				break;
+			}
+
+			unsigned short op = view.opcode(pc);
+			unsigned int x = (op >> 8) & 0xF, y = (op >> 4) & 0xF;
+			auto data = [&](ByteKind kind, unsigned int length)
+			{
+				if (knownI)
+					for (unsigned int i = 0; i < length; i++)
+						mark(I + i, kind);
+			};
+			if (flow.kind != BlockEnd::Invalid)
+			{
+				switch (op & 0xF000)
+				{
+				case 0x5000:
+					if ((op & 0xF) == 2 || (op & 0xF) == 3) // 5XY2 and 5XY3 (XO-CHIP)
+						data(ByteKind::Data, (unsigned int)abs((int)x - (int)y) + 1);
+					break;
+				case 0xA000:
+					I = op & 0x0FFF;
+					knownI = true;
+					break;
+				case 0xD000:
+					if ((op & 0xF) || superChip) // DXY0 draws 16 rows of 2 bytes on SUPER-CHIP
+						data(ByteKind::Sprite, (op & 0xF) ? op & 0xF : 2 * 16);
+					break;
+				case 0xF000:
+					switch (op & 0xFF)
+					{
+					case 0x00: // F000 NNNN (XO-CHIP)
+						I = view.opcode(pc + 2);
+						knownI = true;
+						break;
+					case 0x02:
+						data(ByteKind::Data, AUDIO_PATTERN_LENGTH);
+						break;
+					case 0x1E:
+					case 0x29:
+					case 0x30:
+						knownI = false;
+						break;
+					case 0x33:
+						data(ByteKind::Data, 3);
+						break;
+					case 0x55:
+					case 0x65:
+						data(ByteKind::Data, x + 1);
+						if (increment == IndexIncrement::XPlus1)
+							I += x + 1;
+						else if (increment == IndexIncrement::X)
+							I += x;
+						break;
+					}
+					break;
+				}
+			}
+
+			pc += flow.length;
+			block.end = (uint16_t)pc;
+			if (flow.kind == BlockEnd::Next && !leader[view.wrap(pc)])
+				continue;
+
+			block.kind = flow.kind;
+			block.callee = flow.callee;
+			block.successors.assign(flow.targets, flow.targets + flow.targetCount);
+			if (flow.kind == BlockEnd::Call)
+				cfg.subroutines.push_back(flow.callee);
+			else if (flow.kind == BlockEnd::Indirect)
+				cfg.indirectJumps.push_back((uint16_t)(pc - flow.length));
+			else if (flow.kind == BlockEnd::Invalid)
+				cfg.invalid.push_back((uint16_t)(pc - flow.length));
+			break;
+		}
+		cfg.blocks.push_back(std::move(block));
+	}
+
+	std::sort(cfg.subroutines.begin(), cfg.subroutines.end());
+	cfg.subroutines.erase(std::unique(cfg.subroutines.begin(), cfg.subroutines.end()), cfg.subroutines.end());
+	return cfg;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "Platform.h"
+
+#define CFG_ADDRESSES 65536 // Up to the 64 KB of XO-CHIP
+
+/*
+ * What a byte of the ROM was found to be
+*/
+enum class ByteKind : unsigned char
+{
+	Unknown, // Not reached by the code, or only through an indirect access
+	Code, // First byte of an instruction
+	Operand, // Rest of an instruction (second byte, the address of F000 NNNN)
+	Sprite, // Drawn by DXYN with I set by ANNN or F000 NNNN
+	Data // Read or written by FX33, FX55, FX65, 5XY2, 5XY3 or F002 with a known I
+};
+
+/*
+ * How a basic block ends
+*/
+enum class BlockEnd : unsigned char
+{
+	Next, // Falls through into the next block, which is the target of a jump
+	Jump, // 1NNN
+	Call, // 2NNN, the block after it is where the subroutine returns
+	Return, // 00EE
+	Skip, // 3XNN, 4XNN, 5XY0, 9XY0, EX9E, EXA1: the next instruction or the one after
+	Indirect, // BNNN, only the target for V0 (VX) = 0 is known
+	Loop, // A jump to itself, the usual end of a program
+	Exit, // 00FD (SUPER-CHIP)
+	Invalid, // An opcode the platform doesn't have, the program would stop
+	OutOfRom // Runs past the end of the ROM
+};
+
+/*
+ * Instructions run in sequence from start to end (excluded), entered only at start
+*/
+struct BasicBlock
+{
+	uint16_t start;
+	uint16_t end;
+	BlockEnd kind;
+	std::vector<uint16_t> successors; // Jump, skip and fall through targets. A call goes on at its return address.
+	uint16_t callee = 0; // Subroutine of a Call block
+};
+
+/*
+ * Control flow graph of a ROM, recovered statically by following the code from 0x200: jumps, calls,
+ * skips and fall throughs. The bytes drawn as sprites or used as data through a constant I are told apart
+ * from the code, the rest of the ROM was not reached.
+ * This is the structure of the program for the tools that need more than one instruction at a time,
+ * e.g. chip8-disasm, instead of each one finding it again.
+*/
+struct ControlFlowGraph
+{
+	Platform platform = Platform::SuperChip;
+	std::vector<BasicBlock> blocks; // In address order
+	std::vector<uint16_t> subroutines; // Targets of 2NNN, in address order
+	std::vector<uint16_t> indirectJumps; // Addresses of the BNNN instructions
+	std::vector<uint16_t> invalid; // Addresses of the reachable opcodes the platform doesn't have
+	std::vector<ByteKind> bytes = std::vector<ByteKind>(CFG_ADDRESSES, ByteKind::Unknown);
+	int overlaps = 0; // Distinct bytes used as two kinds, e.g. code also drawn as a sprite or misaligned code
+
+	/*
+	 * Block starting at addr, nullptr if none
+	*/
+	const BasicBlock* blockAt(unsigned int addr) const;
+};
+
+/*
+ * Recover the control flow graph of a ROM loaded at 0x200
+*/
+ControlFlowGraph buildControlFlow(std::span<const uint8_t> rom, Platform platform);
@@ -0,0 +1,472 @@
+#include "Debugger.h"
+#include "Disassembler.h"
+#include "Interpreter.h"
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#define LIST_LINES 5 // Instructions printed from the pc on every stop
+
+static const char* const registerNames[] = { "I", "DT", "ST", "SP" };
+static const char* const compareNames[] = { "==", "!=", "<", "<=", ">", ">=" };
+
+static std::string hex(unsigned int value, int digits)
+{
+	std::string text(digits, '0');
+	for (int i = digits - 1; i >= 0; i--, value >>= 4)
+		text[i] = "0123456789ABCDEF"[value & 0xF];
+	return text;
+}
+
+/*
+ * Number in base 16 or 10, or in hexadecimal with 0x whatever the base
+*/
+static bool parseNumber(const std::string& text, int base, unsigned int& value)
+{
+	const char* digits = text.c_str();
+	if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+	{
+		digits += 2;
+		base = 16;
+	}
+	char* end;
+	unsigned long parsed = strtoul(digits, &end, base);
+	if (end == digits || *end != '\0' || parsed > 0xFFFF)
+		return false;
+	value = (unsigned int)parsed;
+	return true;
+}
+
+bool DebugCondition::holds(const Chip8& c) const
+{
+	unsigned int actual;
+	switch (reg)
+	{
+	case None: return true;
+	case I: actual = c.I; break;
+	case DT: actual = c.delay_timer; break;
+	case ST: actual = c.sound_timer; break;
+	case SP: actual = c.sp; break;
+	default: actual = c.V[reg];
+	}
+
+	switch (compare)
+	{
+	case Equal: return actual == value;
+	case NotEqual: return actual != value;
+	case Less: return actual < value;
+	case LessEqual: return actual <= value;
+	case Greater: return actual > value;
+	default: return actual >= value;
+	}
+}
+
+bool DebugCondition::parse(const std::string& text)
+{
+	// The longest operators first, so "<=" isn't taken for "<"
+	static const Compare order[] = { Equal, NotEqual, LessEqual, GreaterEqual, Less, Greater };
+	for (Compare op : order)
+	{
+		size_t at = text.find(compareNames[op]);
+		if (at == std::string::npos)
+			continue;
+
+		std::string name = text.substr(0, at);
+		for (char& ch : name)
+			ch = (char)toupper((unsigned char)ch);
+		unsigned char parsedReg = None;
+		if (name.size() == 2 && name[0] == 'V' && isxdigit((unsigned char)name[1]))
+			parsedReg = (unsigned char)strtoul(name.c_str() + 1, nullptr, 16);
+		for (int r = 0; r < 4; r++)
+			if (name == registerNames[r])
+				parsedReg = (unsigned char)(I + r);
+
+		unsigned int parsedValue;
+		if (parsedReg == None || !parseNumber(text.substr(at + strlen(compareNames[op])), 10, parsedValue))
+			return false;
+		reg = parsedReg;
+		compare = op;
+		value = parsedValue;
+		return true;
+	}
+	return false;
+}
+
+std::string DebugCondition::text() const
+{
+	if (reg == None)
+		return "";
+	std::string name = reg < V_LENGTH ? "V" + hex(reg, 1) : registerNames[reg - I];
+	return name + compareNames[compare] + std::to_string(value);
+}
+
+int Debugger::run(Chip8& c, int cycles)
+{
+	int executed = 0;
+	withPlatform(c.platform, [&](auto p)
+		{
+			using Debugging = Interpreter<decltype(p), Debugger>;
+			while (!isPaused && executed < cycles)
+			{
+				if (c.exited)
+				{
+					stop(DebugStop::Exited, c.halted ? "halted on an unknown opcode" : "exited");
+					break;
+				}
+
+				// Stop before the instruction, unless the program is resumed from this breakpoint
+				if (!resuming && breakpointAt(c))
+					break;
+				resuming = false;
+
+				Debugging::cycle(c, *this);
+				executed++;
+				if (watchHit)
+				{
+					watchHit = false;
+					stop(DebugStop::Watchpoint, message);
+					break;
+				}
+				if (steps && --steps == 0)
+				{
+					stop(DebugStop::Step, "");
+					break;
+				}
+			}
+		});
+	return executed;
+}
+
+bool Debugger::breakpointAt(const Chip8& c)
+{
+	// The bitmap keeps the search for the addresses without breakpoints
+	if (!anywhere && !((bitmap[c.pc >> 6] >> (c.pc & 63)) & 1))
+		return false;
+	for (const Breakpoint& b : breakpoints)
+		if ((b.addr == c.pc || b.addr == DEBUG_ANYWHERE) && b.condition.holds(c))
+		{
+			if (b.temporary)
+				stop(DebugStop::Step, "");
+			else
+				stop(DebugStop::Breakpoint, "breakpoint at " + hex(c.pc, 4) + (b.condition.reg != DebugCondition::None ? ", " + b.condition.text() : ""));
+			return true;
+		}
+	return false;
+}
+
+void Debugger::checkAccess(const Chip8& c, unsigned int addr, unsigned int length, MemoryAccess kind)
+{
+	for (const Watchpoint& w : watchpoints)
+	{
+		if (!(w.access & kind))
+			continue;
+		for (unsigned int i = 0; i < length; i++)
+		{
+			unsigned int at = (addr + i) & (c.memSize - 1); // As the interpreter wraps it
+			if (at - w.addr < w.length)
+			{
+				message = std::string(kind == MemoryWrite ? "write of " : "read of ") + hex(at, 4) + " by " + hex(c.opcode, 4)
+					+ " " + disassemble(c.opcode, c.platform) + " at " + hex(c.pc, 4);
+				watchHit = true;
+				return;
+			}
+		}
+	}
+}
+
+void Debugger::stop(DebugStop why, const std::string& text)
+{
+	isPaused = true;
+	steps = 0;
+	reason = why;
+	message = text;
+
+	// The step over is done, or interrupted
+	for (size_t i = 0; i < breakpoints.size();)
+		if (breakpoints[i].temporary)
+		{
+			int addr = breakpoints[i].addr;
+			breakpoints.erase(breakpoints.begin() + i);
+			updateBitmap(addr);
+		}
+		else
+			i++;
+}
+
+void Debugger::pause()
+{
+	if (!isPaused)
+		stop(DebugStop::Requested, "paused");
+}
+
+void Debugger::resume()
+{
+	isPaused = false;
+	resuming = true;
+	steps = 0;
+}
+
+void Debugger::step(int n)
+{
+	resume();
+	steps = n > 0 ? n : 1;
+}
+
+void Debugger::stepOver(const Chip8& c)
+{
+	if ((c.read16(c.pc) & 0xF000) != 0x2000)
+	{
+		step();
+		return;
+	}
+
+	// Back from the subroutine: the next instruction with the same stack pointer, so a recursion runs until it returns
+	DebugCondition sameDepth;
+	sameDepth.reg = DebugCondition::SP;
+	sameDepth.value = c.sp;
+	int next = (c.pc + 2) & (c.memSize - 1);
+	breakpoints.push_back({ next, sameDepth, true });
+	updateBitmap(next);
+	resume();
+}
+
+void Debugger::setBreakpoint(int addr, const DebugCondition& condition)
+{
+	breakpoints.push_back({ addr, condition, false });
+	updateBitmap(addr);
+}
+
+bool Debugger::clearBreakpoint(int addr)
+{
+	size_t before = breakpoints.size();
+	for (size_t i = 0; i < breakpoints.size();)
+		if (breakpoints[i].addr == addr && !breakpoints[i].temporary)
+			breakpoints.erase(breakpoints.begin() + i);
+		else
+			i++;
+	updateBitmap(addr);
+	return breakpoints.size() != before;
+}
+
+bool Debugger::hasBreakpoint(int addr) const
+{
+	for (const Breakpoint& b : breakpoints)
+		if (b.addr == addr && !b.temporary)
+			return true;
+	return false;
+}
+
+void Debugger::updateBitmap(int addr)
+{
+	if (addr == DEBUG_ANYWHERE)
+	{
+		anywhere = 0;
+		for (const Breakpoint& b : breakpoints)
+			anywhere += b.addr == DEBUG_ANYWHERE;
+		return;
+	}
+
+	bool any = false;
+	for (const Breakpoint& b : breakpoints)
+		any |= b.addr == addr;
+	if (any)
+		bitmap[addr >> 6] |= 1ull << (addr & 63);
+	else
+		bitmap[addr >> 6] &= ~(1ull << (addr & 63));
+}
+
+void Debugger::setWatchpoint(unsigned int addr, unsigned int length, unsigned char access)
+{
+	watchpoints.push_back({ addr, length ? length : 1, access });
+}
+
+bool Debugger::clearWatchpoint(unsigned int addr)
+{
+	size_t before = watchpoints.size();
+	for (size_t i = 0; i < watchpoints.size();)
+		if (watchpoints[i].addr == addr)
+			watchpoints.erase(watchpoints.begin() + i);
+		else
+			i++;
+	return watchpoints.size() != before;
+}
+
+void Debugger::printState(const Chip8& c, std::ostream& out) const
+{
+	out << "pc " << hex(c.pc, 4) << "  I " << hex(c.I, 4) << "  sp " << c.sp << "  DT " << hex(c.delay_timer, 2)
+		<< "  ST " << hex(c.sound_timer, 2) << "\n";
+	for (int i = 0; i < V_LENGTH; i++)
+		out << "V" << hex(i, 1) << " " << hex(c.V[i], 2) << (i % 8 == 7 ? "\n" : "  ");
+	if (c.sp)
+	{
+		out << "stack";
+		for (int i = 0; i < c.sp; i++)
+			out << " " << hex(c.stack[i], 4);
+		out << "\n";
+	}
+	unsigned int addr = c.pc;
+	for (int i = 0; i < LIST_LINES; i++, addr += 2)
+	{
+		unsigned short opcode = c.read16(addr);
+		out << (i == 0 ? "> " : "  ") << hex(addr & (c.memSize - 1), 4) << ": " << hex(opcode, 4) << "  "
+			<< disassemble(opcode, c.platform) << "\n";
+	}
+}
+
+std::vector<std::string> Debugger::stateLines(const Chip8& c) const
+{
+	std::string v[2];
+	for (int i = 0; i < V_LENGTH; i++)
+		v[i / 8] += " " + hex(c.V[i], 2);
+	unsigned short opcode = c.read16(c.pc);
+	return {
+		isPaused ? (message.empty() ? "paused" : message) : "running",
+		"pc " + hex(c.pc, 4) + "  i " + hex(c.I, 4) + "  sp " + std::to_string(c.sp) + "  dt " + hex(c.delay_timer, 2)
+			+ "  st " + hex(c.sound_timer, 2),
+		"v0-7" + v[0],
+		"v8-f" + v[1],
+		hex(opcode, 4) + "  " + disassemble(opcode, c.platform),
+		"f5 continue  f9 breakpoint  f10 over  f11 step"
+	};
+}
+
+bool Debugger::command(Chip8& c, const std::string& line, std::ostream& out)
+{
+	std::istringstream words(line);
+	std::string name;
+	if (!(words >> name))
+		return true;
+	std::vector<std::string> args;
+	for (std::string arg; words >> arg;)
+		args.push_back(arg);
+
+	// Addresses in hexadecimal, "*" for the breakpoints checked everywhere
+	auto address = [&](size_t i, int& addr, bool anywhereAllowed)
+	{
+		unsigned int value;
+		if (anywhereAllowed && i < args.size() && args[i] == "*")
+		{
+			addr = DEBUG_ANYWHERE;
+			return true;
+		}
+		if (i >= args.size() || !parseNumber(args[i], 16, value))
+		{
+			out << "Expected an address in hexadecimal\n";
+			return false;
+		}
+		addr = (int)value;
+		return true;
+	};
+	auto count = [&](size_t i, unsigned int fallback)
+	{
+		unsigned int value;
+		return i < args.size() && parseNumber(args[i], 10, value) ? value : fallback;
+	};
+
+	int addr;
+	if (name == "q")
+		return false;
+	else if (name == "c")
+		resume();
+	else if (name == "s")
+		step((int)count(0, 1));
+	else if (name == "n")
+		stepOver(c);
+	else if (name == "r")
+		printState(c, out);
+	else if (name == "b" && address(0, addr, true))
+	{
+		DebugCondition condition;
+		if (args.size() > 1 && !condition.parse(args[1]))
+		{
+			out << "Expected a condition like V3==5, I>=0x300 or SP!=0\n";
+			return true;
+		}
+		if (addr == DEBUG_ANYWHERE && condition.reg == DebugCondition::None)
+		{
+			out << "A breakpoint on every instruction needs a condition\n";
+			return true;
+		}
+		setBreakpoint(addr, condition);
+	}
+	else if (name == "d" && address(0, addr, true))
+	{
+		if (!clearBreakpoint(addr))
+			out << "No breakpoint there\n";
+	}
+	else if (name == "w" && address(0, addr, false))
+	{
+		std::string kind = args.size() > 2 ? args[2] : "rw";
+		unsigned char access = (kind.find('r') != std::string::npos ? WatchRead : 0) | (kind.find('w') != std::string::npos ? WatchWrite : 0);
+		setWatchpoint((unsigned int)addr, count(1, 1), access ? access : WatchRead | WatchWrite);
+	}
+	else if (name == "dw" && address(0, addr, false))
+	{
+		if (!clearWatchpoint((unsigned int)addr))
+			out << "No watchpoint there\n";
+	}
+	else if (name == "i")
+	{
+		for (const Breakpoint& b : breakpoints)
+			if (!b.temporary)
+				out << "breakpoint " << (b.addr == DEBUG_ANYWHERE ? "*" : hex(b.addr, 4)) << " " << b.condition.text() << "\n";
+		for (const Watchpoint& w : watchpoints)
+			out << "watchpoint " << hex(w.addr, 4) << " " << w.length << " " << (w.access & WatchRead ? "r" : "")
+				<< (w.access & WatchWrite ? "w" : "") << "\n";
+	}
+	else if (name == "x" && address(0, addr, false))
+	{
+		unsigned int length = count(1, 16);
+		for (unsigned int i = 0; i < length; i++)
+		{
+			if (i % 16 == 0)
+				out << (i ? "\n" : "") << hex((addr + i) & (c.memSize - 1), 4) << ":";
+			out << " " << hex(c.read(addr + i), 2);
+		}
+		out << "\n";
+	}
+	else if (name == "l")
+	{
+		unsigned int from = c.pc;
+		if (!args.empty() && !parseNumber(args[0], 16, from))
+		{
+			out << "Expected an address in hexadecimal\n";
+			return true;
+		}
+		unsigned int lines = count(1, 10);
+		for (unsigned int i = 0; i < lines; i++, from += 2)
+		{
+			unsigned short opcode = c.read16(from);
+			out << ((from & (c.memSize - 1)) == c.pc ? "> " : "  ") << hex(from & (c.memSize - 1), 4) << ": " << hex(opcode, 4)
+				<< "  " << disassemble(opcode, c.platform) << "\n";
+		}
+	}
+	else if (name == "k")
+	{
+		// The keys held from now on, e.g. "k 5 8", none without arguments
+		memset(c.key, 0, sizeof(c.key));
+		for (const std::string& arg : args)
+			for (char ch : arg)
+				if (isxdigit((unsigned char)ch))
+					c.key[strtoul(std::string(1, ch).c_str(), nullptr, 16)] = 1;
+	}
+	else if (name == "help" || name == "h")
+		out << "b <addr|*> [cond]       breakpoint, with a condition like V3==5, I>=0x300, DT!=0 or SP<2\n"
+			"d <addr|*>              delete the breakpoints at addr\n"
+			"w <addr> [len] [r|w|rw] watchpoint on the bytes read and written through I\n"
+			"dw <addr>               delete the watchpoints at addr\n"
+			"i                       list the breakpoints and watchpoints\n"
+			"c                       continue\n"
+			"s [n]                   step n instructions\n"
+			"n                       step, over 2NNN subroutines\n"
+			"r                       registers\n"
+			"x <addr> [len]          memory\n"
+			"l [addr] [n]            disassemble\n"
+			"k [keys]                hold the keys, e.g. k 5 8, release them all without keys\n"
+			"q                       quit\n"
+			"Addresses are in hexadecimal, counts and values in decimal or with 0x.\n";
+	else if (name != "b" && name != "d" && name != "w" && name != "dw" && name != "x")
+		out << "Unknown command, help lists them\n";
+	return true;
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Chip8.h"
+#include "Hooks.h"
+
+#define DEBUG_ADDRESSES 65536 // Up to the 64 KB of XO-CHIP
+#define DEBUG_ANYWHERE -1 // Address of the breakpoints checked at every instruction
+
+/*
+ * Condition of a breakpoint on a register: V0-VF, I, DT, ST or SP compared with a value, e.g. "V3==5"
+*/
+struct DebugCondition
+{
+	enum Register : unsigned char { I = V_LENGTH, DT, ST, SP, None }; // V0-VF are 0-15
+	enum Compare : unsigned char { Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual };
+
+	unsigned char reg = None; // None always holds
+	Compare compare = Equal;
+	unsigned int value = 0;
+
+	bool holds(const Chip8& c) const;
+
+	/*
+	 * Parse "<register><compare><value>", the value in decimal or in hexadecimal with 0x.
+	 * Returns false if the text isn't a condition.
+	*/
+	bool parse(const std::string& text);
+	std::string text() const;
+};
+
+struct Breakpoint
+{
+	int addr; // Or DEBUG_ANYWHERE
+	DebugCondition condition;
+	bool temporary; // Set by stepOver(), removed on the next stop
+};
+
+enum WatchAccess : unsigned char
+{
+	WatchRead = MemoryRead, // I based reads: DXYN, FX65, 5XY3, F002
+	WatchWrite = MemoryWrite // FX33, FX55, 5XY2
+};
+
+struct Watchpoint
+{
+	unsigned int addr;
+	unsigned int length;
+	unsigned char access; // WatchAccess bits
+};
+
+/*
+ * Why the debugger paused
+*/
+enum class DebugStop
+{
+	Requested,
+	Breakpoint,
+	Watchpoint,
+	Step,
+	Exited
+};
+
+/*
+ * Debugger of the program running in a Chip8: breakpoints on addresses with optional register conditions,
+ * watchpoints on the memory the instructions read and write through I, single step and step over of 2NNN.
+ * The debugger is the hooks of its own specialization of the interpreter (see Interpreter.h): run the
+ * program with Debugger::run() instead of Chip8::run() to debug it. The breakpoints are a bitmap of the
+ * addresses checked by that specialization only, Chip8::run() doesn't pay anything for them.
+ * The frontend drives it with hotkeys, chip8-debug with the text commands of command().
+*/
+class Debugger : public NoHooks
+{
+public:
+	/*
+	 * Execute up to cycles instructions with the debugging interpreter of the platform, stopping before a
+	 * breakpoint, after a watched access and at the end of a step. Returns the instructions executed,
+	 * none while paused.
+	*/
+	int run(Chip8& c, int cycles);
+
+	bool paused() const { return isPaused; }
+	DebugStop stopReason() const { return reason; }
+	const std::string& stopMessage() const { return message; }
+
+	void pause();
+	void resume();
+
+	/*
+	 * Execute n instructions with the next runs, then pause
+	*/
+	void step(int n = 1);
+
+	/*
+	 * Step, running a 2NNN subroutine until it returns to the next instruction
+	*/
+	void stepOver(const Chip8& c);
+
+	void setBreakpoint(int addr, const DebugCondition& condition = DebugCondition());
+	bool clearBreakpoint(int addr); // Every breakpoint at the address, returns false if there was none
+	bool hasBreakpoint(int addr) const;
+	void setWatchpoint(unsigned int addr, unsigned int length, unsigned char access);
+	bool clearWatchpoint(unsigned int addr);
+
+	/*
+	 * Execute a text command, e.g. "b 2A4 V3==5", writing the result to out. "help" lists them.
+	 * Returns false on "q". The commands that resume the program return before it runs: run() goes on.
+	*/
+	bool command(Chip8& c, const std::string& line, std::ostream& out);
+
+	/*
+	 * Registers and the next instructions, as printed on every stop
+	*/
+	void printState(const Chip8& c, std::ostream& out) const;
+
+	/*
+	 * Short lines of the registers for the overlay of the frontend
+	*/
+	std::vector<std::string> stateLines(const Chip8& c) const;
+
+	/*
+	 * Hooks of the interpreter, every cycle is stepped and checked for breakpoints even while the program waits
+	*/
+	static constexpr bool skipsIdle = false;
+	void memoryAccess(const Chip8& c, unsigned int addr, unsigned int length, MemoryAccess kind)
+	{
+		if (!watchpoints.empty() && !watchHit)
+			checkAccess(c, addr, length, kind);
+	}
+
+private:
+	bool breakpointAt(const Chip8& c);
+	void checkAccess(const Chip8& c, unsigned int addr, unsigned int length, MemoryAccess kind);
+	void stop(DebugStop why, const std::string& text);
+	void updateBitmap(int addr);
+
+	uint64_t bitmap[DEBUG_ADDRESSES / 64] = {}; // Addresses with a breakpoint
+	std::vector<Breakpoint> breakpoints;
+	int anywhere = 0; // Breakpoints at DEBUG_ANYWHERE
+	std::vector<Watchpoint> watchpoints;
+
+	bool isPaused = false;
+	bool resuming = false; // The breakpoint at the pc was the last stop, don't stop on it again
+	int steps = 0; // Instructions left to step, 0 when running freely
+	bool watchHit = false;
+	DebugStop reason = DebugStop::Requested;
+	std::string message;
+};
@@ -0,0 +1,152 @@
+#include "Disassembler.h"
+
+/*
+ * Hexadecimal number with a fixed number of digits, e.g. hex(0x2A, 3) = "0x02A"
+*/
+static std::string hex(unsigned int value, int digits)
+{
+	std::string text = "0x" + std::string(digits, '0');
+	for (int i = digits + 1; i >= 2; i--, value >>= 4)
+		text[i] = "0123456789ABCDEF"[value & 0xF];
+	return text;
+}
+
+static std::string reg(unsigned int r)
+{
+	return std::string("V") + "0123456789ABCDEF"[r & 0xF];
+}
+
+std::string disassemble(unsigned short opcode, Platform platform)
+{
+	return withPlatform(platform, [&](auto p) -> std::string
+		{
+			using P = decltype(p);
+			unsigned int x = (opcode & 0x0F00) >> 8;
+			unsigned int y = (opcode & 0x00F0) >> 4;
+			unsigned int n = opcode & 0x000F;
+			unsigned int nn = opcode & 0x00FF;
+			unsigned int nnn = opcode & 0x0FFF;
+			std::string vx = reg(x);
+			std::string vy = reg(y);
+
+			switch (opcode & 0xF000)
+			{
+			case 0x0000: // Decoded by the low byte, as the interpreter does
+				if (nn == 0xE0)
+					return "CLS";
+				if (nn == 0xEE)
+					return "RET";
+				if (P::superChip)
+				{
+					if (nn == 0xFB)
+						return "SCR";
+					if (nn == 0xFC)
+						return "SCL";
+					if (nn == 0xFD)
+						return "EXIT";
+					if (nn == 0xFE)
+						return "LOW";
+					if (nn == 0xFF)
+						return "HIGH";
+					if ((nn & 0xF0) == 0xC0)
+						return "SCD " + std::to_string(n);
+				}
+				if (P::xoChip && (nn & 0xF0) == 0xD0)
+					return "SCU " + std::to_string(n);
+				break;
+			case 0x1000: return "JP " + hex(nnn, 3);
+			case 0x2000: return "CALL " + hex(nnn, 3);
+			case 0x3000: return "SE " + vx + ", " + hex(nn, 2);
+			case 0x4000: return "SNE " + vx + ", " + hex(nn, 2);
+			case 0x5000:
+				if (n == 0x0)
+					return "SE " + vx + ", " + vy;
+				if (P::xoChip && n == 0x2)
+					return "SAVE " + vx + " - " + vy;
+				if (P::xoChip && n == 0x3)
+					return "LOAD " + vx + " - " + vy;
+				break;
+			case 0x6000: return "LD " + vx + ", " + hex(nn, 2);
+			case 0x7000: return "ADD " + vx + ", " + hex(nn, 2);
+			case 0x8000:
+				switch (n)
+				{
+				case 0x0: return "LD " + vx + ", " + vy;
+				case 0x1: return "OR " + vx + ", " + vy;
+				case 0x2: return "AND " + vx + ", " + vy;
+				case 0x3: return "XOR " + vx + ", " + vy;
+				case 0x4: return "ADD " + vx + ", " + vy;
+				case 0x5: return "SUB " + vx + ", " + vy;
+				case 0x6: return "SHR " + vx + ", " + vy;
+				case 0x7: return "SUBN " + vx + ", " + vy;
+				case 0xE: return "SHL " + vx + ", " + vy;
+				}
+				break;
+			case 0x9000:
+				if (n == 0x0)
+					return "SNE " + vx + ", " + vy;
+				break;
+			case 0xA000: return "LD I, " + hex(nnn, 3);
+			case 0xB000:
+				if (P::jumpUsesVX)
+					return "JP " + vx + ", " + hex(nnn, 3);
+				return "JP V0, " + hex(nnn, 3);
+			case 0xC000: return "RND " + vx + ", " + hex(nn, 2);
+			case 0xD000: return "DRW " + vx + ", " + vy + ", " + std::to_string(n);
+			case 0xE000:
+				if (nn == 0x9E)
+					return "SKP " + vx;
+				if (nn == 0xA1)
+					return "SKNP " + vx;
+				break;
+			case 0xF000:
+				switch (nn)
+				{
+				case 0x00:
+					if (P::xoChip && x == 0)
+						return "LD I, long";
+					break;
+				case 0x01:
+					if (P::xoChip)
+						return "PLANE " + std::to_string(x);
+					break;
+				case 0x02:
+					if (P::xoChip)
+						return "AUDIO";
+					break;
+				case 0x07: return "LD " + vx + ", DT";
+				case 0x0A: return "LD " + vx + ", K";
+				case 0x15: return "LD DT, " + vx;
+				case 0x18: return "LD ST, " + vx;
+				case 0x1E: return "ADD I, " + vx;
+				case 0x29: return "LD F, " + vx;
+				case 0x30:
+					if (P::superChip)
+						return "LD HF, " + vx;
+					break;
+				case 0x33: return "LD B, " + vx;
+				case 0x3A:
+					if (P::xoChip)
+						return "PITCH " + vx;
+					break;
+				case 0x55: return "LD [I], " + vx;
+				case 0x65: return "LD " + vx + ", [I]";
+				case 0x75:
+					if (P::superChip)
+						return "LD R, " + vx;
+					break;
+				case 0x85:
+					if (P::superChip)
+						return "LD " + vx + ", R";
+					break;
+				}
+				break;
+			}
+			return "DW " + hex(opcode, 4);
+		});
+}
+
+bool validOpcode(unsigned short opcode, Platform platform)
+{
+	return disassemble(opcode, platform).compare(0, 3, "DW ") != 0;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+#include "Platform.h"
+
+/*
+ * Mnemonic of an opcode, in the syntax of Cowgod's CHIP-8 technical reference with the SUPER-CHIP and
+ * XO-CHIP extensions, e.g. "DRW V1, V2, 5". Opcodes the platform doesn't have are shown as data ("DW 0x5AB1").
+ * F000 NNNN (XO-CHIP) is 4 bytes long, its address is the next word and is not part of the mnemonic.
+*/
+std::string disassemble(unsigned short opcode, Platform platform);
+
+/*
+ * The platform has the opcode, the interpreter doesn't stop on it as unknown
+*/
+bool validOpcode(unsigned short opcode, Platform platform);
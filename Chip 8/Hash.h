@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * XXH64 hash (xxHash, 64 bit variant) of a block of memory.
+ * Used to identify ROM images, see RomDatabase.h.
+*/
+uint64_t xxhash64(const void* data, size_t length, uint64_t seed = 0);
+
+/*
+ * Keys of the incremental state hash (see Chip8::fingerprint).
+ * The hash of the memory and of the framebuffer is the XOR of a key per non-zero byte or word, so a write
+ * updates it by removing the key of the old value and adding the key of the new one (Zobrist hashing).
+ * Zeros have no key, cleared memory and a cleared screen add nothing.
+*/
+#define GFX_WORDS 256 // 64 bit words of the framebuffer, 2 planes of 64 rows of 2 words
+
+// splitmix64 finalizer, a bijection so distinct inputs never share a key
+constexpr uint64_t mix64(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xBF58476D1CE4E5B9ULL;
+	x ^= x >> 27;
+	x *= 0x94D049BB133111EBULL;
+	x ^= x >> 31;
+	return x;
+}
+
+inline uint64_t memoryKey(unsigned int addr, unsigned char value)
+{
+	return value ? mix64((uint64_t)addr << 8 | value) : 0;
+}
+
+extern const std::array<uint64_t, GFX_WORDS> gfxWordKeys;
+
+/*
+ * Key of a framebuffer word, by its index in Chip8::gfx
+*/
+inline uint64_t gfxKey(unsigned int word, uint64_t bits)
+{
+	return bits ? mix64(bits ^ gfxWordKeys[word]) : 0;
+}
@@ -0,0 +1,78 @@
+#include "Histogram.h"
+#include <bit>
+#include <cstring>
+#include <string>
+
+void Histogram::reset()
+{
+	memset(counts, 0, sizeof(counts));
+	total = sum = largest = 0;
+}
+
+int Histogram::bucket(uint64_t value)
+{
+	if (value < HISTOGRAM_SUB_BUCKETS)
+		return (int)value;
+
+	// Power of two of the value, then its next HISTOGRAM_SUB_BITS bits below the highest one
+	int power = std::bit_width(value) - HISTOGRAM_SUB_BITS; // 1 for values up to 2 * HISTOGRAM_SUB_BUCKETS
+	int sub = (int)(value >> (power - 1)) - HISTOGRAM_SUB_BUCKETS;
+	return power * HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+uint64_t Histogram::lowest(int bucket)
+{
+	int power = bucket / HISTOGRAM_SUB_BUCKETS;
+	int sub = bucket % HISTOGRAM_SUB_BUCKETS;
+	if (power == 0)
+		return (uint64_t)sub;
+	return (uint64_t)(HISTOGRAM_SUB_BUCKETS + sub) << (power - 1);
+}
+
+uint64_t Histogram::highest(int bucket)
+{
+	int power = bucket / HISTOGRAM_SUB_BUCKETS;
+	return lowest(bucket) + (power == 0 ? 0 : ((uint64_t)1 << (power - 1)) - 1);
+}
+
+uint64_t Histogram::percentile(double q) const
+{
+	if (!total)
+		return 0;
+	uint64_t rank = (uint64_t)(q * total + 0.5);
+	if (rank < 1)
+		rank = 1;
+
+	uint64_t seen = 0;
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+	{
+		seen += counts[i];
+		if (seen >= rank)
+			return highest(i) < largest ? highest(i) : largest;
+	}
+	return largest;
+}
+
+/*
+ * Nanoseconds as milliseconds with 3 decimals, without touching the format flags of the stream
+*/
+static std::string milliseconds(uint64_t ns)
+{
+	std::string decimals = std::to_string(ns / 1000 % 1000);
+	return std::to_string(ns / 1000000) + "." + std::string(3 - decimals.size(), '0') + decimals;
+}
+
+void Histogram::writeSummary(std::ostream& out, const char* name) const
+{
+	out << name << ": " << total << " samples, mean " << milliseconds((uint64_t)mean()) << " ms, p50 "
+		<< milliseconds(percentile(0.5)) << ", p99 " << milliseconds(percentile(0.99)) << ", p999 "
+		<< milliseconds(percentile(0.999)) << ", max " << milliseconds(largest) << " ms\n";
+}
+
+void Histogram::write(std::ostream& out, const char* name) const
+{
+	writeSummary(out, name);
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+		if (counts[i])
+			out << "  <= " << highest(i) << " ns\t" << counts[i] << "\n";
+}
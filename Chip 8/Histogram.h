@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+#define HISTOGRAM_SUB_BITS 5 // 32 buckets per power of two, values are kept within 1/32 (3%)
+#define HISTOGRAM_MAX_BITS 40 // Values up to 2^40 (18 minutes in nanoseconds), larger ones are clamped
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+/*
+ * Histogram of durations with a fixed relative precision, like HdrHistogram.
+ * Values below HISTOGRAM_SUB_BUCKETS have a bucket each, the larger ones are split by their highest bit
+ * into powers of two and each power into HISTOGRAM_SUB_BUCKETS linear buckets.
+ * The buckets are a fixed array: recording is a few instructions and never allocates, so it can be done
+ * every frame, and the percentiles are exact to the precision of a bucket.
+*/
+class Histogram
+{
+public:
+	void record(uint64_t value)
+	{
+		if (value >= (uint64_t)1 << HISTOGRAM_MAX_BITS)
+			value = ((uint64_t)1 << HISTOGRAM_MAX_BITS) - 1;
+		counts[bucket(value)]++;
+		total++;
+		sum += value;
+		if (value > largest)
+			largest = value;
+	}
+
+	void reset();
+
+	uint64_t count() const { return total; }
+	uint64_t max() const { return largest; }
+	double mean() const { return total ? (double)sum / total : 0; }
+
+	/*
+	 * Value below which the fraction q (0 to 1) of the values are, the highest value of its bucket
+	*/
+	uint64_t percentile(double q) const;
+
+	/*
+	 * Count, mean, max and the usual percentiles on one line, in milliseconds for nanosecond values
+	*/
+	void writeSummary(std::ostream& out, const char* name) const;
+
+	/*
+	 * Summary and the non empty buckets, one per line: highest value of the bucket and count
+	*/
+	void write(std::ostream& out, const char* name) const;
+
+	/*
+	 * Bucket of a value and the range of values of a bucket
+	*/
+	static int bucket(uint64_t value);
+	static uint64_t lowest(int bucket);
+	static uint64_t highest(int bucket);
+
+private:
+	uint64_t counts[HISTOGRAM_BUCKETS] = {};
+	uint64_t total = 0;
+	uint64_t sum = 0;
+	uint64_t largest = 0;
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+class Chip8;
+
+/*
+ * Kind of a memory access through I, bits so a watch can take both
+*/
+enum MemoryAccess : unsigned char
+{
+	MemoryRead = 1, // DXYN, FX65, 5XY3, F002
+	MemoryWrite = 2 // FX33, FX55, 5XY2
+};
+
+/*
+ * Hooks called by the interpreter to observe the execution of the program, e.g. the Profiler or the Tracer.
+ * The interpreter is specialized for its hooks as for its platform (see Interpreter.h), these empty ones are
+ * inlined away so the interpreter of Chip8::run() doesn't pay anything for them.
+ * Hooks derive from NoHooks and hide the ones they need.
+*/
+struct NoHooks
+{
+	static constexpr bool skipsIdle = true; // A run waiting in place is skipped (see Interpreter::run), false to see every cycle
+
+	void instruction(const Chip8& c, unsigned short opcode) {} // Fetched at c.pc, before executing it
+	void executed(const Chip8& c, unsigned short pc, unsigned short opcode) {} // Before the timers are updated
+	void call(const Chip8& c, unsigned short target) {} // 2NNN, before pushing c.pc
+	void ret(const Chip8& c) {} // 00EE, before popping the return address
+	void unknownOpcode(const Chip8& c) {} // c.opcode at c.pc
+	void idle(const Chip8& c, int cycles) {} // c.opcode at c.pc waits in place, the cycles of the run are skipped
+	void memoryAccess(const Chip8& c, unsigned int addr, unsigned int length, MemoryAccess kind) {} // Bytes from addr, wrapping at c.memSize, before c.opcode at c.pc accesses them
+};
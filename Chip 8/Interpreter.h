@@ -0,0 +1,833 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+#include "Chip8.h"
+#include "Hooks.h"
+#include "Platform.h"
+
+#define BIG_SPRITE 16 // DXY0 draws a 16x16 sprite (SUPER-CHIP)
+
+/*
+ * Interpreter of the Chip8 specialized at compile time for a platform descriptor (see Platform.h).
+ * Every quirk and every instruction set extension is resolved with if constexpr, so each platform
+ * gets its own switch without any quirk check in the hot loop.
+ * Chip8::initialize() selects the specialization once for the platform of the ROM.
+*/
+template <class P, class H = NoHooks>
+struct Interpreter
+{
+	static constexpr unsigned int addrMask = P::memSize - 1; // Addresses wrap around at the end of the memory
+
+	/*
+	 * Execute an opcode.
+	 * First fetch the opcode, decode, execute it and update timers.
+	*/
+	static void cycle(Chip8& c, H& hooks);
+
+	static void cycle(Chip8& c)
+	{
+		H hooks;
+		cycle(c, hooks);
+	}
+
+	/*
+	 * Execute several cycles.
+	 * A program waiting in place (a jump to itself, FX0A without a key) skips the cycles: it can't go on
+	 * before the keys change between two runs, only its timers would. The wait is checked once per run
+	 * rather than per cycle, so it costs nothing to the programs that don't wait. Hooks that count or stop
+	 * on every cycle turn it off with skipsIdle.
+	*/
+	static void run(Chip8& c, int cycles, H& hooks)
+	{
+		if constexpr (H::skipsIdle)
+		{
+			if (waiting(c))
+			{
+				hooks.idle(c, cycles);
+				skipIdle(c, cycles);
+				return;
+			}
+		}
+		for (int i = 0; i < cycles; i++)
+			cycle(c, hooks);
+	}
+
+	static void run(Chip8& c, int cycles)
+	{
+		H hooks;
+		run(c, cycles, hooks);
+	}
+
+	/*
+	 * The next opcode leaves the pc in place until the keys change
+	*/
+	static bool waiting(Chip8& c)
+	{
+		if (c.exited)
+			return false;
+		unsigned short opcode = c.read16(c.pc, addrMask);
+		if ((opcode & 0xF0FF) == 0xF00A)
+		{
+			for (int i = 0; i < KEY_LENGTH; i++)
+				if (c.key[i])
+					return false;
+		}
+		else if ((opcode & 0xF000) != 0x1000 || (P::memSize > 0x1000 && c.pc > 0x0FFF) || (opcode & 0x0FFF) != c.pc)
+			return false; // Programs end or wait for an interrupt in a jump to itself, NNN only reaches the first 4 KB
+		c.opcode = opcode;
+		return true;
+	}
+
+	/*
+	 * Update the timers as if the waiting opcode was executed cycles times
+	*/
+	static void skipIdle(Chip8& c, int cycles)
+	{
+		c.idleCycles += cycles;
+		c.delay_timer = c.delay_timer > cycles ? c.delay_timer - cycles : 0;
+
+		// The sound plays one more cycle for each cycle the timer counts down, and stops after it reaches 0
+		int sounding = c.sound_timer < cycles ? c.sound_timer : cycles;
+		c.playSound += sounding;
+		c.sound_timer -= sounding;
+		if (sounding < cycles)
+			c.playSound = 0;
+	}
+
+	/*
+	 * Current resolution, constant on platforms without the SUPER-CHIP high resolution
+	*/
+	static int width(const Chip8& c) { return P::superChip ? c.width : LORES_WIDTH; }
+	static int height(const Chip8& c) { return P::superChip ? c.height : LORES_HEIGHT; }
+
+	/*
+	 * Planes affected by drawing, only XO-CHIP can select the second one
+	*/
+	static unsigned char planes(const Chip8& c) { return P::xoChip ? c.planes : 1; }
+
+	/*
+	 * Select the low (64*32) or high (128*64) resolution, clearing every plane
+	*/
+	static void setResolution(Chip8& c, bool high)
+	{
+		c.hires = high;
+		c.width = high ? HIRES_WIDTH : LORES_WIDTH;
+		c.height = high ? HIRES_HEIGHT : LORES_HEIGHT;
+		memset(c.gfx, 0, sizeof(c.gfx));
+		c.gfxHash[0] = c.gfxHash[1] = 0;
+		c.drawFlag = true;
+	}
+
+	/*
+	 * Clear the selected planes
+	*/
+	static void clearScreen(Chip8& c)
+	{
+		for (int p = 0; p < PLANES; p++)
+			if (planes(c) & (1 << p))
+			{
+				memset(c.gfx[p], 0, sizeof(c.gfx[p]));
+				c.gfxHash[p] = 0;
+			}
+		c.drawFlag = true;
+	}
+
+	/*
+	 * XOR a sprite row into a plane of the framebuffer.
+	 * The row bits are left aligned in a 64 bit word and drawn starting at x. The pixels past the right edge
+	 * wrap around or are clipped depending on the platform.
+	 * Returns true if any pixel is flipped from set to unset.
+	*/
+	static bool drawRow(Chip8& c, int plane, int y, int x, uint64_t bits)
+	{
+		uint64_t* row = c.gfx[plane][y];
+		unsigned int index = (plane * HIRES_HEIGHT + y) * ROW_WORDS; // Of the row in the hash keys
+		int word = x >> 6;
+		int shift = x & 63;
+
+		// The sprite row can straddle two words of the framebuffer
+		uint64_t left = bits >> shift;
+		uint64_t right = shift ? bits << (64 - shift) : 0;
+
+		bool collision = (row[word] & left) != 0;
+		c.gfxHash[plane] ^= gfxKey(index + word, row[word]) ^ gfxKey(index + word, row[word] ^ left);
+		row[word] ^= left;
+
+		int next = word + 1;
+		if (next == width(c) / 64) // Past the right edge of the screen
+		{
+			if (!P::wrapSprites)
+				return collision;
+			next = 0;
+		}
+		if (right)
+		{
+			collision |= (row[next] & right) != 0;
+			c.gfxHash[plane] ^= gfxKey(index + next, row[next]) ^ gfxKey(index + next, row[next] ^ right);
+			row[next] ^= right;
+		}
+		return collision;
+	}
+
+	/*
+	 * Hash a whole plane again, after moving its words around
+	*/
+	static void rehashPlane(Chip8& c, int plane)
+	{
+		const uint64_t* words = &c.gfx[plane][0][0];
+		unsigned int first = plane * HIRES_HEIGHT * ROW_WORDS;
+		c.gfxHash[plane] = 0;
+		for (unsigned int i = 0; i < HIRES_HEIGHT * ROW_WORDS; i++)
+			c.gfxHash[plane] ^= gfxKey(first + i, words[i]);
+	}
+
+	/*
+	 * Scrolling of the selected planes (SUPER-CHIP, XO-CHIP). Amounts are in pixels of the current resolution.
+	*/
+	static void scrollDown(Chip8& c, int n)
+	{
+		if (n > c.height)
+			n = c.height;
+		for (int p = 0; p < PLANES; p++)
+			if (planes(c) & (1 << p))
+			{
+				memmove(c.gfx[p][n], c.gfx[p][0], sizeof(c.gfx[p][0]) * (c.height - n));
+				memset(c.gfx[p][0], 0, sizeof(c.gfx[p][0]) * n);
+				rehashPlane(c, p);
+			}
+		c.drawFlag = true;
+	}
+
+	static void scrollUp(Chip8& c, int n)
+	{
+		if (n > c.height)
+			n = c.height;
+		for (int p = 0; p < PLANES; p++)
+			if (planes(c) & (1 << p))
+			{
+				memmove(c.gfx[p][0], c.gfx[p][n], sizeof(c.gfx[p][0]) * (c.height - n));
+				memset(c.gfx[p][c.height - n], 0, sizeof(c.gfx[p][0]) * n);
+				rehashPlane(c, p);
+			}
+		c.drawFlag = true;
+	}
+
+	static void scrollRight(Chip8& c)
+	{
+		for (int p = 0; p < PLANES; p++)
+			if (planes(c) & (1 << p))
+			{
+				for (int y = 0; y < c.height; y++)
+				{
+					uint64_t* row = c.gfx[p][y];
+					if (c.hires) // Shift the 128 bit row across both words
+						row[1] = (row[1] >> 4) | (row[0] << 60);
+					row[0] >>= 4;
+				}
+				rehashPlane(c, p);
+			}
+		c.drawFlag = true;
+	}
+
+	static void scrollLeft(Chip8& c)
+	{
+		for (int p = 0; p < PLANES; p++)
+			if (planes(c) & (1 << p))
+			{
+				for (int y = 0; y < c.height; y++)
+				{
+					uint64_t* row = c.gfx[p][y];
+					row[0] <<= 4;
+					if (c.hires)
+					{
+						row[0] |= row[1] >> 60;
+						row[1] <<= 4;
+					}
+				}
+				rehashPlane(c, p);
+			}
+		c.drawFlag = true;
+	}
+
+	/*
+	 * Skip the next instruction. In XO-CHIP F000 NNNN is 4 bytes long and is skipped entirely.
+	*/
+	static void skip(Chip8& c)
+	{
+		if (P::xoChip && c.read(c.pc + 2, addrMask) == 0xF0 && c.read(c.pc + 3, addrMask) == 0x00)
+			c.pc += 6;
+		else
+			c.pc += 4;
+	}
+
+	static void unknownOpcode(Chip8& c, H& hooks)
+	{
+		hooks.unknownOpcode(c);
+		c.unknownOpcode();
+	}
+};
+
+template <class P, class H>
+void Interpreter<P, H>::cycle(Chip8& c, H& hooks)
+{
+	unsigned char* V = c.V;
+
+	if (c.exited) // 00FD or a halt on an unknown opcode stops the interpreter
+		return;
+
+	/*
+	 * Fetch
+	 * Data is stored in an array in which each address contains one byte.
+	 * As one opcode is 2 bytes long, we will need to fetch two successive bytes and merge them to get the actual opcode.
+	*/
+	unsigned short pc = c.pc;
+	unsigned short opcode = c.read16(pc, addrMask);
+	c.opcode = opcode;
+	hooks.instruction(c, opcode);
+
+	// Decode and execution
+	unsigned short regX = (opcode & 0x0F00) >> 8; // regX based on where the register X is usually located (0x3XNN)
+	unsigned short regY = (opcode & 0x00F0) >> 4;
+
+	switch (opcode & 0xF000)
+	{
+
+	case 0x0000:
+		switch (opcode & 0x00FF)
+		{
+
+		case 0x00E0: // Clears the screen.
+			clearScreen(c);
+			c.pc += 2; // Increase the program counter by 2
+			break;
+
+		case 0x00EE: // Returns from a subroutine.
+			hooks.ret(c);
+			c.sp = (c.sp - 1) & (STACK_LENGTH - 1); // A return without a call wraps around instead of underflowing
+			c.pc = c.stack[c.sp]; // Restore the value of the program counter from the stack
+			c.pc = (c.pc + 2) & addrMask; // Increase the program counter, within the memory
+			break;
+
+		case 0x00FB: // 00FB: Scrolls the screen right by 4 pixels (SUPER-CHIP)
+			if constexpr (P::superChip)
+			{
+				scrollRight(c);
+				c.pc += 2;
+			}
+			else
+				unknownOpcode(c, hooks);
+			break;
+
+		case 0x00FC: // 00FC: Scrolls the screen left by 4 pixels (SUPER-CHIP)
+			if constexpr (P::superChip)
+			{
+				scrollLeft(c);
+				c.pc += 2;
+			}
+			else
+				unknownOpcode(c, hooks);
+			break;
+
+		case 0x00FD: // 00FD: Exits the interpreter (SUPER-CHIP)
+			if constexpr (P::superChip)
+				c.exited = true;
+			else
+				unknownOpcode(c, hooks);
+			break;
+
+		case 0x00FE: // 00FE: Disables the high resolution mode (SUPER-CHIP)
+			if constexpr (P::superChip)
+			{
+				setResolution(c, false);
+				c.pc += 2;
+			}
+			else
+				unknownOpcode(c, hooks);
+			break;
+
+		case 0x00FF: // 00FF: Enables the 128x64 high resolution mode (SUPER-CHIP)
+			if constexpr (P::superChip)
+			{
+				setResolution(c, true);
+				c.pc += 2;
+			}
+			else
+				unknownOpcode(c, hooks);
+			break;
+
+		default:
+			if (P::superChip && (opcode & 0x00F0) == 0x00C0) // 00CN: Scrolls the screen down by N pixels (SUPER-CHIP)
+			{
+				scrollDown(c, opcode & 0x000F);
+				c.pc += 2;
+			}
+			else if (P::xoChip && (opcode & 0x00F0) == 0x00D0) // 00DN: Scrolls the screen up by N pixels (XO-CHIP)
+			{
+				scrollUp(c, opcode & 0x000F);
+				c.pc += 2;
+			}
+			else
+				unknownOpcode(c, hooks);
+		}
+		break;
+
+	case 0x1000: // 0x1NNN: Jumps to address NNN
+		c.pc = opcode & 0x0FFF;
+		break;
+
+	case 0x2000: // 0x2NNN: Calls subroutine at NNN
+		hooks.call(c, opcode & 0x0FFF);
+		c.stack[c.sp] = c.pc; // Save the value of the program counter on the stack and increase it
+		c.sp = (c.sp + 1) & (STACK_LENGTH - 1); // Past 16 levels the oldest return address is overwritten
+		c.pc = opcode & 0x0FFF; // Call the subroutine
+		break;
+
+	case 0x3000: // 0x3XNN: Skips the next instruction if VX equals NN. (Usually the next instruction is a jump to skip a code block)
+		if (V[regX] == (opcode & 0x00FF))
+			skip(c);
+		else
+			c.pc += 2;
+		break;
+
+	case 0x4000: // 0x4XNN: Skips the next instruction if VX doesn't equal NN. (Usually the next instruction is a jump to skip a code block)
+		if (V[regX] != (opcode & 0x00FF))
+			skip(c);
+		else
+			c.pc += 2;
+		break;
+
+	case 0x5000:
+		switch (opcode & 0x000F)
+		{
+		case 0x0000: // 0x5XY0: Skips the next instruction if VX equals VY. (Usually the next instruction is a jump to skip a code block)
+			if (V[regX] == V[regY])
+				skip(c);
+			else
+				c.pc += 2;
+			break;
+
+		case 0x0002: // 0x5XY2: Store VX to VY inclusive in memory starting at address I, in reverse order if X > Y. I is not changed (XO-CHIP)
+			if constexpr (P::xoChip)
+			{
+				int dir = regX <= regY ? 1 : -1;
+				hooks.memoryAccess(c, c.I & addrMask, abs(regY - regX) + 1, MemoryWrite);
+				for (int i = 0; i <= abs(regY - regX); i++)
+					c.write(c.I + i, V[regX + i * dir], addrMask);
+				c.pc += 2;
+			}
+			else
+				unknownOpcode(c, hooks);
+			break;
+
+		case 0x0003: // 0x5XY3: Fill VX to VY inclusive with the values stored in memory starting at address I. I is not changed (XO-CHIP)
+			if constexpr (P::xoChip)
+			{
+				int dir = regX <= regY ? 1 : -1;
+				hooks.memoryAccess(c, c.I & addrMask, abs(regY - regX) + 1, MemoryRead);
+				for (int i = 0; i <= abs(regY - regX); i++)
+					V[regX + i * dir] = c.read(c.I + i, addrMask);
+				c.pc += 2;
+			}
+			else
+				unknownOpcode(c, hooks);
+			break;
+
+		default:
+			unknownOpcode(c, hooks);
+		}
+		break;
+
+	case 0x6000: // 0x6XNN: Sets VX to NN
+		V[regX] = (opcode & 0x00FF);
+		c.pc += 2;
+		break;
+
+	case 0x7000: // 0x7XNN: Adds NN to VX. (Carry flag is not changed)
+		V[regX] = V[regX] + (opcode & 0x00FF);
+		c.pc += 2;
+		break;
+
+	case 0x8000:
+	{
+		switch (opcode & 0x000F) {
+
+		case 0x0000: // 8XY0: Sets VX to the value of VY
+			V[regX] = V[regY];
+			c.pc += 2;
+			break;
+
+		case 0x0001: // 8XY1: Sets VX to VX or VY. (Bitwise OR operation)
+			V[regX] |= V[regY];
+			if constexpr (P::logicResetsVF)
+				V[0xF] = 0;
+			c.pc += 2;
+			break;
+
+		case 0x0002: // 8XY2: Sets VX to VX and VY. (Bitwise AND operation)
+			V[regX] &= V[regY];
+			if constexpr (P::logicResetsVF)
+				V[0xF] = 0;
+			c.pc += 2;
+			break;
+
+		case 0x0003: // 8XY3: Sets VX to VX xor VY
+			V[regX] ^= V[regY];
+			if constexpr (P::logicResetsVF)
+				V[0xF] = 0;
+			c.pc += 2;
+			break;
+
+		case 0x0004: // 8XY4: Adds VY to VX. VF is set to 1 when there's a carry, and to 0 when there isn't
+			if (V[regY] > (0xFF - V[regX]))
+				V[0xF] = 1; // There's a carry
+			else
+				V[0xF] = 0;
+			V[regX] += V[regY];
+			c.pc += 2;
+			break;
+
+		case 0x0005: // 8XY5: VY is subtracted from VX. VF is set to 0 when there's a borrow, and 1 when there isn't
+			if (V[regY] > V[regX])
+				V[0xF] = 0; // There's a borrow
+			else
+				V[0xF] = 1;
+			V[regX] -= V[regY];
+			c.pc += 2;
+			break;
+
+		case 0x0006: // 8XY6: Stores the least significant bit of VX (VY on the VIP) in VF and then shifts it to the right by 1 into VX
+		{
+			unsigned char value = P::shiftUsesVY ? V[regY] : V[regX];
+			V[0xF] = value & 0x1;
+			V[regX] = value >> 1;
+			c.pc += 2;
+		}
+		break;
+
+		case 0x0007: // 8XY7: Sets VX to VY minus VX. VF is set to 0 when there's a borrow, and 1 when there isn't
+			if (V[regX] > V[regY]) // VY - VX
+				V[0xF] = 0; // There's a borrow
+			else
+				V[0xF] = 1;
+			V[regX] = V[regY] - V[regX];
+			c.pc += 2;
+			break;
+
+		case 0x000E: // 8XYE: Stores the most significant bit of VX (VY on the VIP) in VF and then shifts it to the left by 1 into VX
+		{
+			unsigned char value = P::shiftUsesVY ? V[regY] : V[regX];
+			V[0xF] = value >> 7;
+			V[regX] = value << 1;
+			c.pc += 2;
+		}
+		break;
+
+		default:
+			unknownOpcode(c, hooks);
+		}
+		break;
+	}
+
+	case 0x9000: // 9XY0: Skips the next instruction if VX doesn't equal VY. (Usually the next instruction is a jump to skip a code block)
+		if (V[regX] != V[regY])
+			skip(c);
+		else
+			c.pc += 2;
+		break;
+
+	case 0xA000: // ANNN: Sets I to the address NNN
+		c.I = opcode & 0x0FFF;
+		c.pc += 2;
+		break;
+
+	case 0xB000:
+		// The target wraps around at the end of the memory, like any address
+		if constexpr (P::jumpUsesVX) // BXNN: Jumps to the address XNN plus VX (CHIP-48, SUPER-CHIP)
+			c.pc = ((opcode & 0x0FFF) + V[regX]) & addrMask;
+		else // BNNN: Jumps to the address NNN plus V0
+			c.pc = ((opcode & 0x0FFF) + V[0]) & addrMask;
+		break;
+
+	case 0xC000: // CXNN: Sets VX to the result of a bitwise and operation on a random number (Typically: 0 to 255) and NN.
+		c.random ^= c.random << 13;
+		c.random ^= c.random >> 17;
+		c.random ^= c.random << 5;
+		V[regX] = (c.random % 255) & (opcode & 0x00FF);
+		c.pc += 2;
+		break;
+
+	case 0xD000:
+		/* 0xDXYN:
+		 * Draws a sprite at coordinate (VX, VY) that has a width of 8 pixels and a height of N pixels.
+		 * Each row of 8 pixels is read as bit-coded starting from memory location I; I value doesn't change after the execution of this instruction.
+		 * As described above, VF is set to 1 if any screen pixels are flipped from set to unset when the sprite is drawn, and to 0 if that doesn't happen
+		*/
+
+	{
+		/*
+		 * DXY0 draws a 16x16 sprite, two bytes per row (SUPER-CHIP).
+		 * The sprite starts at the coordinates wrapped into the screen. The pixels past the edges wrap around
+		 * or are clipped depending on the platform.
+		 * With both XO-CHIP planes selected, the sprite for the second plane follows the one for the first plane.
+		*/
+		unsigned short rows = opcode & 0x000F;
+		bool big = P::superChip && rows == 0;
+		if (big)
+			rows = BIG_SPRITE;
+
+		const int w = width(c);
+		const int h = height(c);
+		int x = V[regX] & (w - 1);
+		int y = V[regY] & (h - 1);
+		unsigned short addr = c.I;
+
+		V[0xF] = 0; // Reset register VF
+		for (int p = 0; p < PLANES; p++)
+		{
+			if (!(planes(c) & (1 << p)))
+				continue;
+
+			for (int yLine = 0; yLine < rows; yLine++) // Loop over each row
+			{
+				int row = y + yLine;
+				if (row >= h)
+				{
+					if (!P::wrapSprites)
+						break;
+					row -= h;
+				}
+
+				uint64_t bits; // Row of the sprite read from memory, left aligned
+				if (big)
+				{
+					hooks.memoryAccess(c, (addr + 2 * yLine) & addrMask, 2, MemoryRead);
+					bits = (uint64_t)c.read16(addr + 2 * yLine, addrMask) << 48;
+				}
+				else
+				{
+					hooks.memoryAccess(c, (addr + yLine) & addrMask, 1, MemoryRead);
+					bits = (uint64_t)c.read(addr + yLine, addrMask) << 56;
+				}
+
+				if (drawRow(c, p, row, x, bits)) // Register the collision by setting the VF register
+					V[0xF] = 1;
+			}
+			addr += big ? 2 * rows : rows;
+		}
+
+		c.drawFlag = true;
+		c.pc += 2;
+	}
+	break;
+
+	case 0xE000:
+		switch (opcode & 0x00FF)
+		{
+		case 0x009E: // EX9E: Skips the next instruction if the key stored in VX is pressed (the low 4 bits of VX)
+			if (c.key[V[regX] & 0xF] != 0)
+				skip(c);
+			else
+				c.pc += 2;
+			break;
+
+		case 0x00A1: // EXA1: Skips the next instruction if the key stored in VX isn't pressed
+			if (c.key[V[regX] & 0xF] == 0)
+				skip(c);
+			else
+				c.pc += 2;
+			break;
+
+		default:
+			unknownOpcode(c, hooks);
+		}
+		break;
+
+	case 0xF000:
+		switch (opcode & 0x00FF)
+		{
+		case 0x0000: // F000 NNNN: Sets I to the 16 bit address NNNN stored in the next two bytes (XO-CHIP)
+			if (P::xoChip && regX == 0)
+			{
+				c.I = c.read16(c.pc + 2, addrMask);
+				c.pc += 4;
+			}
+			else
+				unknownOpcode(c, hooks);
+			break;
+
+		case 0x0001: // FN01: Selects the planes N (bitmask) used for drawing, clearing and scrolling (XO-CHIP)
+			if constexpr (P::xoChip)
+			{
+				c.planes = regX & 0x3;
+				c.pc += 2;
+			}
+			else
+				unknownOpcode(c, hooks);
+			break;
+
+		case 0x0002: // F002: Load the 16 byte audio pattern buffer from memory starting at address I (XO-CHIP)
+			if constexpr (P::xoChip)
+			{
+				hooks.memoryAccess(c, c.I & addrMask, AUDIO_PATTERN_LENGTH, MemoryRead);
+				for (int i = 0; i < AUDIO_PATTERN_LENGTH; i++)
+					c.audioPattern[i] = c.read(c.I + i, addrMask);
+				c.audioPatternLoaded = true;
+				c.pc += 2;
+			}
+			else
+				unknownOpcode(c, hooks);
+			break;
+
+		case 0x0007: // FX07: Sets VX to the value of the delay timer
+			V[regX] = c.delay_timer;
+			c.pc += 2;
+			break;
+
+		case 0x000A: // FX0A: A key press is awaited, and then stored in VX. (Blocking Operation. All instruction halted until next key event)
+		{
+			bool  pressed = false;
+			for (int i = 0; i < KEY_LENGTH && !pressed; i++)
+			{
+				if (c.key[i] != 0)
+				{
+					pressed = true;
+					V[regX] = i;
+				}
+			}
+			if (pressed) // If the key was pressed, increase the program counter. Otherwise, skip the cycle
+				c.pc += 2;
+		}
+		break;
+
+		case 0x0015: // FX15: Sets the delay timer to VX
+			c.delay_timer = V[regX];
+			c.pc += 2;
+			break;
+
+		case 0x0018: // FX18: Sets the sound timer to VX
+			c.sound_timer = V[regX];
+			c.pc += 2;
+			break;
+
+		case 0x001E: // FX1E: Adds VX to I
+			if constexpr (P::indexOverflowSetsVF)
+			{
+				unsigned int sum = c.I + V[regX];
+				V[0xF] = sum > 0x0FFF;
+				c.I = sum;
+			}
+			else
+				c.I += V[regX];
+			c.pc += 2;
+			break;
+
+		case 0x0029: // FX29: Set I to the memory address of the sprite data corresponding to the hexadecimal digit stored in register VX
+			c.I = FONT_ADDR + V[regX] * 0x5;
+			c.pc += 2;
+			break;
+
+		case 0x0030: // FX30: Set I to the memory address of the 8x10 sprite of the hexadecimal digit stored in register VX (SUPER-CHIP)
+			if constexpr (P::superChip)
+			{
+				c.I = BIGFONT_ADDR + (V[regX] & 0xF) * 10;
+				c.pc += 2;
+			}
+			else
+				unknownOpcode(c, hooks);
+			break;
+
+		case 0x0033: // FX33: Store the binary-coded decimal equivalent of the value stored in register VX at addresses I, I+1, and I+2
+			hooks.memoryAccess(c, c.I & addrMask, 3, MemoryWrite);
+			c.write(c.I, V[regX] / 100, addrMask);
+			c.write(c.I + 1, (V[regX] / 10) % 10, addrMask);
+			c.write(c.I + 2, (V[regX] % 100) % 10, addrMask);
+			c.pc += 2;
+			break;
+
+		case 0x003A: // FX3A: Sets the audio pattern playback pitch to VX (XO-CHIP)
+			if constexpr (P::xoChip)
+			{
+				c.pitch = V[regX];
+				c.pc += 2;
+			}
+			else
+				unknownOpcode(c, hooks);
+			break;
+
+		case 0x0055: // FX55: Store the values of registers V0 to VX inclusive in memory starting at address I
+			hooks.memoryAccess(c, c.I & addrMask, regX + 1, MemoryWrite);
+			for (int i = 0; i <= regX; i++)
+				c.write(c.I + i, V[i], addrMask);
+			/*
+			 * The VIP left I set to I + X + 1 after the operation, CHIP-48 to I + X.
+			 * Modern interpreters (starting with SUPER-CHIP in the early 90s) used a temporary variable for indexing,
+			 * so when the instruction was finished, I would still hold the same value as it did before.
+			*/
+			if constexpr (P::loadStoreIncrement == IndexIncrement::XPlus1)
+				c.I += regX + 1;
+			else if constexpr (P::loadStoreIncrement == IndexIncrement::X)
+				c.I += regX;
+			c.pc += 2;
+			break;
+
+		case 0x0065: // FX65: Fill registers V0 to VX inclusive with the values stored in memory starting at address I
+			hooks.memoryAccess(c, c.I & addrMask, regX + 1, MemoryRead);
+			for (int i = 0; i <= regX; i++)
+				V[i] = c.read(c.I + i, addrMask);
+			// I changes as in FX55
+			if constexpr (P::loadStoreIncrement == IndexIncrement::XPlus1)
+				c.I += regX + 1;
+			else if constexpr (P::loadStoreIncrement == IndexIncrement::X)
+				c.I += regX;
+			c.pc += 2;
+			break;
+
+		case 0x0075: // FX75: Store V0 to VX inclusive in the RPL user flags (SUPER-CHIP)
+			if constexpr (P::superChip)
+			{
+				for (int i = 0; i <= regX; i++)
+					c.rpl[i] = V[i];
+				c.pc += 2;
+			}
+			else
+				unknownOpcode(c, hooks);
+			break;
+
+		case 0x0085: // FX85: Fill V0 to VX inclusive with the RPL user flags (SUPER-CHIP)
+			if constexpr (P::superChip)
+			{
+				for (int i = 0; i <= regX; i++)
+					V[i] = c.rpl[i];
+				c.pc += 2;
+			}
+			else
+				unknownOpcode(c, hooks);
+			break;
+
+		default:
+			unknownOpcode(c, hooks);
+		}
+		break;
+
+	default:
+		unknownOpcode(c, hooks);
+	}
+
+	// The pc wraps around at the end of the memory like every address, once here for all the ways it moves
+	c.pc &= addrMask;
+	hooks.executed(c, pc, opcode);
+
+	// Update timers
+	if (c.delay_timer > 0)
+		c.delay_timer--;
+
+	if (c.sound_timer > 0)
+	{
+		if (c.sound_timer != 0)
+			c.playSound++;
+		c.sound_timer--;
+	}
+	else
+		c.playSound = 0;
+}
@@ -0,0 +1,146 @@
+#include "Log.h"
+#include "RomDatabase.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#define LOG_POLL_MS 10 // The log thread checks the queue 100 times per second
+
+static_assert((LOG_QUEUE_LENGTH & (LOG_QUEUE_LENGTH - 1)) == 0, "The queue is indexed with a mask");
+
+/*
+ * Hexadecimal number with a fixed number of digits, formatted without the flags of std::cout that
+ * other threads are using
+*/
+static std::string hex(unsigned int value, int digits)
+{
+	std::string text = "0x" + std::string(digits, '0');
+	for (int i = digits + 1; i >= 2; i--, value >>= 4)
+		text[i] = "0123456789ABCDEF"[value & 0xF];
+	return text;
+}
+
+LogSink& LogSink::global()
+{
+	static LogSink sink;
+	return sink;
+}
+
+LogSink::LogSink()
+{
+	for (size_t i = 0; i < LOG_QUEUE_LENGTH; i++)
+		cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+LogSink::~LogSink()
+{
+	if (running.exchange(false))
+		thread.join();
+}
+
+void LogSink::start()
+{
+	running = true;
+	thread = std::thread(&LogSink::drain, this);
+}
+
+bool LogSink::post(const LogMessage& message)
+{
+	if (!enabled.load(std::memory_order_relaxed))
+	{
+		droppedCount.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	std::call_once(started, &LogSink::start, this);
+
+	size_t pos = pushPos.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		Cell& cell = cells[pos & (LOG_QUEUE_LENGTH - 1)];
+		size_t sequence = cell.sequence.load(std::memory_order_acquire);
+		intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+		if (diff == 0) // Free for this position, claim it
+		{
+			if (pushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+			{
+				cell.message = message;
+				cell.sequence.store(pos + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (diff < 0) // Still holds the message of the previous round, the queue is full
+		{
+			droppedCount.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		else // Another thread claimed it first
+			pos = pushPos.load(std::memory_order_relaxed);
+	}
+}
+
+bool LogSink::pop(LogMessage& message)
+{
+	Cell& cell = cells[popPos & (LOG_QUEUE_LENGTH - 1)];
+	if (cell.sequence.load(std::memory_order_acquire) != popPos + 1)
+		return false;
+	message = cell.message;
+	cell.sequence.store(popPos + LOG_QUEUE_LENGTH, std::memory_order_release); // Free for the next round
+	popPos++;
+	return true;
+}
+
+void LogSink::drain()
+{
+	using clock = std::chrono::steady_clock;
+	clock::time_point second = clock::now();
+	int written = 0; // In the current second
+	uint64_t reported = 0; // Dropped messages already reported
+
+	for (bool last = false; !last; )
+	{
+		last = !running.load();
+
+		LogMessage message;
+		while (pop(message))
+		{
+			if (written < LOG_RATE)
+			{
+				write(message);
+				written++;
+			}
+			else
+				droppedCount.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		if (clock::now() - second >= std::chrono::seconds(1) || last)
+		{
+			uint64_t dropped = droppedCount.load(std::memory_order_relaxed);
+			if (dropped != reported && enabled.load(std::memory_order_relaxed))
+				std::cout << std::to_string(dropped - reported) + " more errors not logged\n";
+			reported = dropped;
+			second = clock::now();
+			written = 0;
+		}
+		if (!last)
+			std::this_thread::sleep_for(std::chrono::milliseconds(LOG_POLL_MS));
+	}
+	std::cout.flush();
+}
+
+void LogSink::write(const LogMessage& message)
+{
+	static const char* const actions[] = { "skipped", "halted", "trapped" };
+
+	const RomInfo& info = findRom(message.romHash);
+	std::string line;
+	switch (message.event)
+	{
+	case LogEvent::UnknownOpcode:
+		line = "Unknown opcode " + hex(message.opcode, 4) + " at " + hex(message.pc, 4);
+		break;
+	}
+	if (info.name)
+		line += std::string(" in ") + info.name;
+	line += std::string(", ") + actions[(int)message.action] + "\n";
+	std::cout << line; // One write per line, so lines of other threads don't cut it
+}
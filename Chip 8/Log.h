@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#define LOG_QUEUE_LENGTH 1024 // Messages waiting to be written, a power of two
+#define LOG_RATE 20 // Messages written per second at most, the others are dropped and counted
+
+/*
+ * Errors of the emulated programs
+*/
+enum class LogEvent : uint8_t
+{
+	UnknownOpcode
+};
+
+/*
+ * What the interpreter did after the error (see UnknownOpcodePolicy)
+*/
+enum class LogAction : uint8_t
+{
+	Skipped,
+	Halted,
+	Trapped
+};
+
+/*
+ * Fixed size message, formatted by the log thread so posting it costs no formatting
+*/
+struct LogMessage
+{
+	LogEvent event;
+	LogAction action;
+	uint16_t pc;
+	uint16_t opcode;
+	uint64_t romHash;
+};
+
+/*
+ * Asynchronous log of the errors of the emulated programs.
+ * Emulator threads post messages to a lock-free bounded queue and never wait. A background thread, started
+ * by the first message, formats them and writes at most LOG_RATE per second to std::cout.
+ * Messages over the rate or posted while the queue is full are dropped and counted, so a program
+ * executing garbage millions of times costs a queue push each time instead of a console write.
+*/
+class LogSink
+{
+public:
+	/*
+	 * The log of the process
+	*/
+	static LogSink& global();
+
+	~LogSink();
+
+	/*
+	 * Queue a message. Returns false if it is dropped, the log is disabled or the queue is full.
+	*/
+	bool post(const LogMessage& message);
+
+	/*
+	 * Drop the messages instead of writing them, e.g. while benchmarking
+	*/
+	void setEnabled(bool enable) { enabled.store(enable, std::memory_order_relaxed); }
+
+	/*
+	 * Messages dropped so far
+	*/
+	uint64_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+
+private:
+	LogSink();
+	void start();
+	void drain(); // Log thread
+	bool pop(LogMessage& message);
+	void write(const LogMessage& message);
+
+	/*
+	 * Bounded multi producer queue of Dmitry Vyukov. The sequence of each cell tells whether it is free
+	 * for the producer of a position or holds the message of the consumer, so pushing is a single
+	 * compare and swap of the position.
+	*/
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		LogMessage message;
+	};
+	Cell cells[LOG_QUEUE_LENGTH];
+	std::atomic<size_t> pushPos{ 0 };
+	size_t popPos = 0; // Only the log thread pops
+
+	std::atomic<bool> enabled{ true };
+	std::atomic<bool> running{ false };
+	std::atomic<uint64_t> droppedCount{ 0 };
+	std::once_flag started;
+	std::thread thread;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/*
+ * Read-only memory mapping of a whole file.
+ * The file is opened once and the mapping lives as long as the object.
+*/
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/*
+	 * Map the file. Returns false if it can't be opened or mapped.
+	*/
+	bool open(const char* path);
+
+	void close();
+
+	std::span<const uint8_t> bytes() const { return { data, length }; }
+
+private:
+	const uint8_t* data = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void* mapping = nullptr; // HANDLE of the file mapping
+#endif
+};
@@ -0,0 +1,103 @@
+#include "Metrics.h"
+#include <filesystem>
+#include <fstream>
+
+/*
+ * Counters of the file: name, help and the member of WorkerMetrics
+*/
+struct MetricInfo
+{
+	const char* name;
+	const char* help;
+	std::atomic<uint64_t> WorkerMetrics::* counter;
+};
+
+static const MetricInfo counters[] =
+{
+	{ "chip8_instructions_total", "Instructions executed by the interpreter", &WorkerMetrics::instructions },
+	{ "chip8_idle_cycles_total", "Cycles skipped while the programs waited in place (jump to itself, FX0A)", &WorkerMetrics::idleCycles },
+	{ "chip8_frames_total", "Frames emulated, each instance counted", &WorkerMetrics::frames },
+	{ "chip8_unknown_opcodes_total", "Unknown opcodes met by the programs", &WorkerMetrics::unknownOpcodes },
+	{ "chip8_snapshots_total", "Machine states copied to reset or fork instances", &WorkerMetrics::snapshots },
+	{ "chip8_snapshot_bytes_total", "Bytes of the machine states copied", &WorkerMetrics::snapshotBytes },
+	{ "chip8_roms_total", "ROMs run to the end", &WorkerMetrics::roms }
+};
+
+MetricsExporter::MetricsExporter(int workers)
+	: workers(workers), metrics(new WorkerMetrics[workers]), lastInstructions(new uint64_t[workers]())
+{
+	lastWrite = std::chrono::steady_clock::now();
+}
+
+MetricsExporter::~MetricsExporter()
+{
+	stop();
+}
+
+void MetricsExporter::start(const char* newPath, int intervalMs)
+{
+	path = newPath;
+	interval = std::chrono::milliseconds(intervalMs);
+	running = true;
+	thread = std::thread(&MetricsExporter::loop, this);
+}
+
+void MetricsExporter::stop()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (!running)
+			return;
+		running = false;
+	}
+	wake.notify_one();
+	thread.join();
+	write();
+}
+
+void MetricsExporter::loop()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	while (running)
+	{
+		if (wake.wait_for(guard, interval, [this] { return !running; }))
+			break;
+		guard.unlock();
+		write();
+		guard.lock();
+	}
+}
+
+bool MetricsExporter::write()
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(now - lastWrite).count();
+	lastWrite = now;
+
+	std::string temp = path + ".tmp";
+	std::ofstream out(temp);
+	for (const MetricInfo& info : counters)
+	{
+		out << "# HELP " << info.name << " " << info.help << "\n# TYPE " << info.name << " counter\n";
+		for (int w = 0; w < workers; w++)
+			out << info.name << "{worker=\"" << w << "\"} " << (metrics[w].*info.counter).load(std::memory_order_relaxed) << "\n";
+	}
+
+	out << "# HELP chip8_instructions_per_second Instructions executed per second since the previous write\n"
+		"# TYPE chip8_instructions_per_second gauge\n";
+	for (int w = 0; w < workers; w++)
+	{
+		uint64_t instructions = metrics[w].instructions.load(std::memory_order_relaxed);
+		uint64_t rate = seconds > 0 ? (uint64_t)((instructions - lastInstructions[w]) / seconds) : 0;
+		lastInstructions[w] = instructions;
+		out << "chip8_instructions_per_second{worker=\"" << w << "\"} " << rate << "\n";
+	}
+	out.close();
+	if (out.fail())
+		return false;
+
+	// Replace the previous file at once
+	std::error_code error;
+	std::filesystem::rename(temp, path, error);
+	return !error;
+}
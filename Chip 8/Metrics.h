@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "Chip8.h"
+
+#define METRICS_INTERVAL_MS 5000 // Default time between two writes of the metrics file
+
+/*
+ * Counters of one worker thread. The worker is the only writer, the exporter reads them while it runs.
+ * Each worker has its own cache line so the workers don't slow each other down.
+*/
+struct alignas(CACHE_LINE) WorkerMetrics
+{
+	std::atomic<uint64_t> instructions{ 0 }; // Executed by the interpreter
+	std::atomic<uint64_t> idleCycles{ 0 }; // Skipped while the programs waited in place
+	std::atomic<uint64_t> frames{ 0 };
+	std::atomic<uint64_t> unknownOpcodes{ 0 };
+	std::atomic<uint64_t> snapshots{ 0 }; // States copied to reset or fork instances
+	std::atomic<uint64_t> snapshotBytes{ 0 };
+	std::atomic<uint64_t> roms{ 0 }; // ROMs done
+
+	/*
+	 * Add to a counter of this worker, without the cost of an atomic read-modify-write
+	*/
+	static void add(std::atomic<uint64_t>& counter, uint64_t n)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+};
+
+/*
+ * Live metrics of a headless run, written periodically as a Prometheus text file for the node exporter
+ * textfile collector or any scraper reading local files.
+ * The file is written next to its path and renamed over it, so a reader never sees half of it.
+ * The instructions per second of each worker are measured between two writes.
+*/
+class MetricsExporter
+{
+public:
+	explicit MetricsExporter(int workers);
+	~MetricsExporter();
+
+	WorkerMetrics& worker(int i) { return metrics[i]; }
+
+	/*
+	 * Write the file every intervalMs milliseconds from a background thread, until stop()
+	*/
+	void start(const char* path, int intervalMs = METRICS_INTERVAL_MS);
+
+	/*
+	 * Stop the thread and write the final values
+	*/
+	void stop();
+
+	/*
+	 * Write the file now. Returns false if it can't be written.
+	*/
+	bool write();
+
+private:
+	void loop();
+
+	int workers;
+	std::unique_ptr<WorkerMetrics[]> metrics;
+	std::string path;
+	std::chrono::milliseconds interval{ METRICS_INTERVAL_MS };
+
+	// Instructions of each worker at the previous write, for the rates
+	std::unique_ptr<uint64_t[]> lastInstructions;
+	std::chrono::steady_clock::time_point lastWrite;
+
+	std::thread thread;
+	std::mutex lock;
+	std::condition_variable wake;
+	bool running = false;
+};
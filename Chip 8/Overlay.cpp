@@ -0,0 +1,77 @@
+#include "Overlay.h"
+#include <cctype>
+
+#define GLYPH_WIDTH 3
+#define GLYPH_HEIGHT 5
+
+/*
+ * Rows of a glyph from the top, the highest of the 3 bits is the left pixel
+*/
+struct Glyph
+{
+	char ch;
+	unsigned char rows[GLYPH_HEIGHT];
+};
+
+static const Glyph font[] =
+{
+	{ '0', { 7, 5, 5, 5, 7 } }, { '1', { 2, 6, 2, 2, 7 } }, { '2', { 7, 1, 7, 4, 7 } }, { '3', { 7, 1, 7, 1, 7 } },
+	{ '4', { 5, 5, 7, 1, 1 } }, { '5', { 7, 4, 7, 1, 7 } }, { '6', { 7, 4, 7, 5, 7 } }, { '7', { 7, 1, 2, 2, 2 } },
+	{ '8', { 7, 5, 7, 5, 7 } }, { '9', { 7, 5, 7, 1, 7 } },
+	{ 'a', { 2, 5, 7, 5, 5 } }, { 'b', { 6, 5, 6, 5, 6 } }, { 'c', { 3, 4, 4, 4, 3 } }, { 'd', { 6, 5, 5, 5, 6 } },
+	{ 'e', { 7, 4, 6, 4, 7 } }, { 'f', { 7, 4, 6, 4, 4 } }, { 'g', { 3, 4, 5, 5, 3 } }, { 'h', { 5, 5, 7, 5, 5 } },
+	{ 'i', { 7, 2, 2, 2, 7 } }, { 'j', { 1, 1, 1, 5, 2 } }, { 'k', { 5, 5, 6, 5, 5 } }, { 'l', { 4, 4, 4, 4, 7 } },
+	{ 'm', { 5, 7, 7, 5, 5 } }, { 'n', { 6, 5, 5, 5, 5 } }, { 'o', { 2, 5, 5, 5, 2 } }, { 'p', { 6, 5, 6, 4, 4 } },
+	{ 'q', { 2, 5, 5, 6, 3 } }, { 'r', { 6, 5, 6, 5, 5 } }, { 's', { 3, 4, 2, 1, 6 } }, { 't', { 7, 2, 2, 2, 2 } },
+	{ 'u', { 5, 5, 5, 5, 7 } }, { 'v', { 5, 5, 5, 5, 2 } }, { 'w', { 5, 5, 7, 7, 5 } }, { 'x', { 5, 5, 2, 5, 5 } },
+	{ 'y', { 5, 5, 2, 2, 2 } }, { 'z', { 7, 1, 2, 4, 7 } },
+	{ '.', { 0, 0, 0, 0, 2 } }, { ':', { 0, 2, 0, 2, 0 } }, { '%', { 5, 1, 2, 4, 5 } }, { '-', { 0, 0, 7, 0, 0 } },
+	{ '/', { 1, 1, 2, 4, 4 } }
+};
+
+static const Glyph* findGlyph(char ch)
+{
+	ch = (char)tolower((unsigned char)ch);
+	for (const Glyph& glyph : font)
+		if (glyph.ch == ch)
+			return &glyph;
+	return nullptr;
+}
+
+void drawOverlay(SDL_Renderer* renderer, const std::vector<std::string>& lines)
+{
+	const int advance = (GLYPH_WIDTH + 1) * OVERLAY_SCALE;
+	const int lineHeight = (GLYPH_HEIGHT + 2) * OVERLAY_SCALE;
+
+	// Draw in window pixels, then go back to the resolution of the emulator
+	int logicalWidth, logicalHeight;
+	SDL_RenderGetLogicalSize(renderer, &logicalWidth, &logicalHeight);
+	SDL_RenderSetLogicalSize(renderer, 0, 0);
+
+	size_t columns = 0;
+	for (const std::string& line : lines)
+		if (line.size() > columns)
+			columns = line.size();
+	SDL_Rect box = { 0, 0, (int)columns * advance + 2 * OVERLAY_MARGIN, (int)lines.size() * lineHeight + 2 * OVERLAY_MARGIN };
+	SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xFF);
+	SDL_RenderFillRect(renderer, &box);
+
+	SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0x00, 0xFF);
+	for (size_t l = 0; l < lines.size(); l++)
+		for (size_t i = 0; i < lines[l].size(); i++)
+		{
+			const Glyph* glyph = findGlyph(lines[l][i]);
+			if (!glyph)
+				continue;
+			for (int y = 0; y < GLYPH_HEIGHT; y++)
+				for (int x = 0; x < GLYPH_WIDTH; x++)
+					if (glyph->rows[y] & (4 >> x))
+					{
+						SDL_Rect pixel = { OVERLAY_MARGIN + (int)i * advance + x * OVERLAY_SCALE,
+							OVERLAY_MARGIN + (int)l * lineHeight + y * OVERLAY_SCALE, OVERLAY_SCALE, OVERLAY_SCALE };
+						SDL_RenderFillRect(renderer, &pixel);
+					}
+		}
+
+	SDL_RenderSetLogicalSize(renderer, logicalWidth, logicalHeight);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <SDL.h>
+#include <string>
+#include <vector>
+
+#define OVERLAY_SCALE 2 // Window pixels per font pixel
+#define OVERLAY_MARGIN 4 // Window pixels around the text
+
+/*
+ * Lines of text drawn over the top left of the window with a built-in 3x5 pixel font, for the statistics
+ * of the emulator. Letters are drawn lowercase, characters the font doesn't have are drawn as spaces.
+ * The text is drawn in window pixels whatever the logical size of the renderer, which is kept.
+*/
+void drawOverlay(SDL_Renderer* renderer, const std::vector<std::string>& lines);
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstring>
+
+/*
+ * Platform variants of the CHIP-8 and their quirks.
+ * Each variant is described at compile time, the interpreter is specialized for each one
+ * so the quirks cost nothing while running (see Interpreter.h).
+*/
+enum class Platform
+{
+	Vip, // Original COSMAC VIP interpreter
+	Chip48, // CHIP-48 on the HP48
+	Modern, // Common behaviour of modern CHIP-8 interpreters and test ROMs
+	SuperChip, // SUPER-CHIP 1.1
+	XoChip // XO-CHIP (Octo)
+};
+
+/*
+ * How FX55/FX65 change the I register after the operation
+*/
+enum class IndexIncrement
+{
+	None, // I is not changed
+	X, // I += X
+	XPlus1 // I += X + 1
+};
+
+/*
+ * COSMAC VIP: 64x32, 4 KB.
+*/
+struct VipPlatform
+{
+	static constexpr Platform id = Platform::Vip;
+	static constexpr const char* name = "VIP";
+	static constexpr unsigned int memSize = 4096;
+	static constexpr bool superChip = false; // SUPER-CHIP instructions and 128x64 high resolution
+	static constexpr bool xoChip = false; // XO-CHIP instructions and bitplanes
+	static constexpr bool shiftUsesVY = true; // 8XY6/8XYE shift VY into VX instead of shifting VX
+	static constexpr IndexIncrement loadStoreIncrement = IndexIncrement::XPlus1;
+	static constexpr bool jumpUsesVX = false; // BXNN jumps to XNN + VX instead of BNNN jumping to NNN + V0
+	static constexpr bool logicResetsVF = true; // 8XY1/8XY2/8XY3 set VF to 0
+	static constexpr bool wrapSprites = false; // Sprite pixels past the edges wrap around instead of being clipped
+	static constexpr bool indexOverflowSetsVF = false; // FX1E sets VF when I goes past 0xFFF, as the SUPER-CHIP game Spacefight 2091! expects
+};
+
+/*
+ * CHIP-48: 64x32, 4 KB.
+*/
+struct Chip48Platform
+{
+	static constexpr Platform id = Platform::Chip48;
+	static constexpr const char* name = "CHIP-48";
+	static constexpr unsigned int memSize = 4096;
+	static constexpr bool superChip = false;
+	static constexpr bool xoChip = false;
+	static constexpr bool shiftUsesVY = false;
+	static constexpr IndexIncrement loadStoreIncrement = IndexIncrement::X;
+	static constexpr bool jumpUsesVX = true;
+	static constexpr bool logicResetsVF = false;
+	static constexpr bool wrapSprites = false;
+	static constexpr bool indexOverflowSetsVF = false;
+};
+
+/*
+ * Modern CHIP-8 as most interpreters implement it: CHIP-48 shifts and no I increment, but BNNN jumps with V0.
+ * 64x32, 4 KB.
+*/
+struct ModernPlatform
+{
+	static constexpr Platform id = Platform::Modern;
+	static constexpr const char* name = "CHIP-8 (modern)";
+	static constexpr unsigned int memSize = 4096;
+	static constexpr bool superChip = false;
+	static constexpr bool xoChip = false;
+	static constexpr bool shiftUsesVY = false;
+	static constexpr IndexIncrement loadStoreIncrement = IndexIncrement::None;
+	static constexpr bool jumpUsesVX = false;
+	static constexpr bool logicResetsVF = false;
+	static constexpr bool wrapSprites = false;
+	static constexpr bool indexOverflowSetsVF = false;
+};
+
+/*
+ * SUPER-CHIP 1.1: 128x64, 4 KB.
+*/
+struct SuperChipPlatform
+{
+	static constexpr Platform id = Platform::SuperChip;
+	static constexpr const char* name = "SUPER-CHIP 1.1";
+	static constexpr unsigned int memSize = 4096;
+	static constexpr bool superChip = true;
+	static constexpr bool xoChip = false;
+	static constexpr bool shiftUsesVY = false;
+	static constexpr IndexIncrement loadStoreIncrement = IndexIncrement::None;
+	static constexpr bool jumpUsesVX = true;
+	static constexpr bool logicResetsVF = false;
+	static constexpr bool wrapSprites = false;
+	static constexpr bool indexOverflowSetsVF = true;
+};
+
+/*
+ * XO-CHIP: 128x64, two bitplanes, 64 KB.
+*/
+struct XoChipPlatform
+{
+	static constexpr Platform id = Platform::XoChip;
+	static constexpr const char* name = "XO-CHIP";
+	static constexpr unsigned int memSize = 65536;
+	static constexpr bool superChip = true;
+	static constexpr bool xoChip = true;
+	static constexpr bool shiftUsesVY = true;
+	static constexpr IndexIncrement loadStoreIncrement = IndexIncrement::XPlus1;
+	static constexpr bool jumpUsesVX = false;
+	static constexpr bool logicResetsVF = false;
+	static constexpr bool wrapSprites = true;
+	static constexpr bool indexOverflowSetsVF = false;
+};
+
+/*
+ * Call f with the descriptor of the platform, so a runtime platform can select a specialized template once:
+ *     withPlatform(platform, [&](auto p) { using P = decltype(p); ... });
+*/
+template <class F>
+auto withPlatform(Platform platform, F&& f)
+{
+	switch (platform)
+	{
+	case Platform::Vip: return f(VipPlatform());
+	case Platform::Chip48: return f(Chip48Platform());
+	case Platform::Modern: return f(ModernPlatform());
+	case Platform::SuperChip: return f(SuperChipPlatform());
+	default: return f(XoChipPlatform());
+	}
+}
+
+/*
+ * Platform named on a command line: vip, chip48, modern, schip or xochip.
+ * Returns false for any other name.
+*/
+inline bool parsePlatform(const char* name, Platform& platform)
+{
+	static const char* const names[] = { "vip", "chip48", "modern", "schip", "xochip" };
+	for (int p = 0; p < (int)(sizeof(names) / sizeof(names[0])); p++)
+		if (strcmp(name, names[p]) == 0)
+		{
+			platform = (Platform)p;
+			return true;
+		}
+	return false;
+}
@@ -0,0 +1,197 @@
+#include "Profiler.h"
+#include "Interpreter.h"
+#include <algorithm>
+#include <map>
+#include <string>
+
+/*
+ * Class of an opcode, named after its encoding as in the comments of the interpreter
+*/
+static const char* opcodeClass(unsigned short opcode)
+{
+	switch (opcode >> 12)
+	{
+	case 0x0:
+		switch (opcode)
+		{
+		case 0x00E0: return "00E0";
+		case 0x00EE: return "00EE";
+		case 0x00FB: return "00FB";
+		case 0x00FC: return "00FC";
+		case 0x00FD: return "00FD";
+		case 0x00FE: return "00FE";
+		case 0x00FF: return "00FF";
+		}
+		if ((opcode & 0xFFF0) == 0x00C0)
+			return "00CN";
+		if ((opcode & 0xFFF0) == 0x00D0)
+			return "00DN";
+		return "0NNN";
+	case 0x1: return "1NNN";
+	case 0x2: return "2NNN";
+	case 0x3: return "3XNN";
+	case 0x4: return "4XNN";
+	case 0x5:
+		switch (opcode & 0x000F)
+		{
+		case 0x0: return "5XY0";
+		case 0x2: return "5XY2";
+		case 0x3: return "5XY3";
+		}
+		return "5XYN";
+	case 0x6: return "6XNN";
+	case 0x7: return "7XNN";
+	case 0x8:
+	{
+		static const char* const names[16] =
+		{
+			"8XY0", "8XY1", "8XY2", "8XY3", "8XY4", "8XY5", "8XY6", "8XY7",
+			"8XYN", "8XYN", "8XYN", "8XYN", "8XYN", "8XYN", "8XYE", "8XYN"
+		};
+		return names[opcode & 0x000F];
+	}
+	case 0x9: return "9XY0";
+	case 0xA: return "ANNN";
+	case 0xB: return "BNNN";
+	case 0xC: return "CXNN";
+	case 0xD: return "DXYN";
+	case 0xE:
+		switch (opcode & 0x00FF)
+		{
+		case 0x9E: return "EX9E";
+		case 0xA1: return "EXA1";
+		}
+		return "EXNN";
+	default:
+		switch (opcode & 0x00FF)
+		{
+		case 0x00: return "F000";
+		case 0x01: return "FN01";
+		case 0x02: return "F002";
+		case 0x07: return "FX07";
+		case 0x0A: return "FX0A";
+		case 0x15: return "FX15";
+		case 0x18: return "FX18";
+		case 0x1E: return "FX1E";
+		case 0x29: return "FX29";
+		case 0x30: return "FX30";
+		case 0x33: return "FX33";
+		case 0x3A: return "FX3A";
+		case 0x55: return "FX55";
+		case 0x65: return "FX65";
+		case 0x75: return "FX75";
+		case 0x85: return "FX85";
+		}
+		return "FXNN";
+	}
+}
+
+/*
+ * Address in 4 hexadecimal digits, without touching the format flags of the stream
+*/
+static std::string hex(unsigned int address)
+{
+	std::string digits(4, '0');
+	for (int i = 3; i >= 0; i--, address >>= 4)
+		digits[i] = "0123456789ABCDEF"[address & 0xF];
+	return digits;
+}
+
+static std::string percent(uint64_t count, uint64_t total)
+{
+	unsigned int tenths = total ? (unsigned int)(count * 1000 / total) : 0;
+	return std::to_string(tenths / 10) + "." + std::to_string(tenths % 10) + "%";
+}
+
+Profiler::Profiler() : addresses(ADDRESSES), opcodes(OPCODES)
+{
+	frames.push_back({ 0, 0, 0 });
+}
+
+void Profiler::run(Chip8& c, int cycles)
+{
+	withPlatform(c.platform, [&](auto p)
+		{
+			Interpreter<decltype(p), Profiler>::run(c, cycles, *this);
+		});
+}
+
+void Profiler::call(const Chip8& c, unsigned short target)
+{
+	// Follow the stack pointer, the frames stay right even if the program unbalances its calls
+	while (frames[frame].depth > c.sp)
+		frame = frames[frame].parent;
+
+	uint64_t key = (uint64_t)frame << 16 | target;
+	auto it = children.find(key);
+	if (it == children.end())
+	{
+		it = children.emplace(key, (int)frames.size()).first;
+		frames.push_back({ target, frame, c.sp + 1 });
+	}
+	frame = it->second;
+	frames[frame].calls++;
+}
+
+void Profiler::ret(const Chip8& c)
+{
+	int depth = c.sp ? c.sp - 1 : 0;
+	while (frames[frame].depth > depth)
+		frame = frames[frame].parent;
+}
+
+void Profiler::report(std::ostream& out, int top) const
+{
+	out << "Profile: " << total << " instructions" << std::endl;
+
+	// Hottest addresses
+	std::vector<unsigned int> hot;
+	for (unsigned int a = 0; a < ADDRESSES; a++)
+		if (addresses[a])
+			hot.push_back(a);
+	std::sort(hot.begin(), hot.end(), [&](unsigned int a, unsigned int b) { return addresses[a] > addresses[b]; });
+	if ((int)hot.size() > top)
+		hot.resize(top);
+	out << std::endl << "Address  Instructions" << std::endl;
+	for (unsigned int a : hot)
+		out << hex(a) << "     " << addresses[a] << " (" << percent(addresses[a], total) << ")" << std::endl;
+
+	// Instructions per opcode class
+	std::map<std::string, uint64_t> classes;
+	for (unsigned int o = 0; o < OPCODES; o++)
+		if (opcodes[o])
+			classes[opcodeClass((unsigned short)o)] += opcodes[o];
+	std::vector<std::pair<std::string, uint64_t>> sorted(classes.begin(), classes.end());
+	std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+	out << std::endl << "Opcode   Instructions" << std::endl;
+	for (const auto& [name, count] : sorted)
+		out << name << "     " << count << " (" << percent(count, total) << ")" << std::endl;
+
+	// Instructions executed in each subroutine itself, whatever the caller
+	std::map<unsigned short, std::pair<uint64_t, uint64_t>> subroutines; // Instructions and calls
+	for (size_t f = 1; f < frames.size(); f++)
+	{
+		subroutines[frames[f].address].first += frames[f].instructions;
+		subroutines[frames[f].address].second += frames[f].calls;
+	}
+	std::vector<std::pair<unsigned short, std::pair<uint64_t, uint64_t>>> calls(subroutines.begin(), subroutines.end());
+	std::sort(calls.begin(), calls.end(), [](const auto& a, const auto& b) { return a.second.first > b.second.first; });
+	out << std::endl << "Subroutine  Instructions  Calls" << std::endl;
+	out << "start       " << frames[0].instructions << " (" << percent(frames[0].instructions, total) << ")" << std::endl;
+	for (const auto& [address, counts] : calls)
+		out << "sub_" << hex(address) << "    " << counts.first << " (" << percent(counts.first, total) << ")  " << counts.second << std::endl;
+}
+
+void Profiler::writeCollapsed(std::ostream& out) const
+{
+	for (size_t f = 0; f < frames.size(); f++)
+	{
+		if (!frames[f].instructions)
+			continue;
+
+		std::string stack;
+		for (int i = (int)f; i != 0; i = frames[i].parent)
+			stack = ";sub_" + hex(frames[i].address) + stack;
+		out << "start" << stack << " " << frames[f].instructions << "\n";
+	}
+}
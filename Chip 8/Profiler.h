@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+#include "Chip8.h"
+#include "Hooks.h"
+
+#define ADDRESSES 65536 // Up to the 64 KB of XO-CHIP
+#define OPCODES 65536
+
+/*
+ * Profile of the program running in a Chip8, for ROM authors looking for their hot loops.
+ * Counts the instructions executed at each address and of each opcode, and attributes them to the
+ * 2NNN/00EE call stack they ran in.
+ * The profiler is the hooks of its own specialization of the interpreter (see Interpreter.h): run the
+ * program with Profiler::run() instead of Chip8::run() to profile it, Chip8::run() is not slowed down.
+*/
+class Profiler : public NoHooks
+{
+public:
+	Profiler();
+
+	/*
+	 * Execute several cycles with the profiling interpreter of the platform
+	*/
+	void run(Chip8& c, int cycles);
+
+	/*
+	 * Hottest addresses, instructions per opcode class and per subroutine
+	*/
+	void report(std::ostream& out, int top = 20) const;
+
+	/*
+	 * One line per call stack with the instructions executed in it, e.g. "start;sub_02A6;sub_0312 1234".
+	 * This is the collapsed stack format read by flamegraph.pl and speedscope.
+	*/
+	void writeCollapsed(std::ostream& out) const;
+
+	/*
+	 * Hooks of the interpreter, every cycle is counted even while the program waits
+	*/
+	static constexpr bool skipsIdle = false;
+	void instruction(const Chip8& c, unsigned short opcode)
+	{
+		addresses[c.pc]++;
+		opcodes[opcode]++;
+		frames[frame].instructions++;
+		total++;
+	}
+	void call(const Chip8& c, unsigned short target);
+	void ret(const Chip8& c);
+
+	std::vector<uint64_t> addresses; // Instructions executed at each address
+	std::vector<uint64_t> opcodes; // Executions of each opcode
+	uint64_t total = 0;
+
+private:
+	/*
+	 * Node of the call tree, one per distinct call stack. Frame 0 is the code outside any subroutine.
+	*/
+	struct Frame
+	{
+		unsigned short address; // Of the subroutine
+		int parent;
+		int depth;
+		uint64_t instructions = 0; // Executed in the subroutine itself, not in the ones it calls
+		uint64_t calls = 0;
+	};
+
+	std::vector<Frame> frames;
+	std::unordered_map<uint64_t, int> children; // Frame called from a frame, keyed by parent << 16 | address
+	int frame = 0; // Current
+};
@@ -0,0 +1,52 @@
+#include "RomDatabase.h"
+#include <algorithm>
+#include <iterator>
+
+/*
+ * Known ROMs, sorted by hash.
+ * Most programs of the collection, and the test ROMs, expect the behaviour of modern interpreters.
+*/
+static const RomInfo database[] =
+{
+	{ 0x04068f4deafe8b10ULL, "INVADERS", Platform::Chip48, 12, DEFAULT_KEYMAP },
+	{ 0x1d1c8cb168b27784ULL, "VERS", Platform::Modern, 12, DEFAULT_KEYMAP },
+	{ 0x20c1eca6aba1aa91ULL, "TICTAC", Platform::Modern, 9, DEFAULT_KEYMAP },
+	{ 0x2c5d40e668b88d02ULL, "BC_test", Platform::Modern, 30, DEFAULT_KEYMAP },
+	{ 0x2f50095261d7c24dULL, "BRIX", Platform::Modern, 12, DEFAULT_KEYMAP },
+	{ 0x3853bf050d100eb6ULL, "TETRIS", Platform::Chip48, 12, "xs23wadqe1zc4rfv" }, // W rotates, A/D move, S drops
+	{ 0x42bdaf39c631566eULL, "KALEID", Platform::Vip, 9, DEFAULT_KEYMAP },
+	{ 0x43cc889074473082ULL, "GUESS", Platform::Modern, 9, DEFAULT_KEYMAP },
+	{ 0x464bd1257fc7e281ULL, "PONG2", Platform::Modern, 9, DEFAULT_KEYMAP },
+	{ 0x47e1744327ff56a4ULL, "MISSILE", Platform::Modern, 9, DEFAULT_KEYMAP },
+	{ 0x52d01dfb1c22b4e6ULL, "IBM_Logo", Platform::Vip, 9, DEFAULT_KEYMAP },
+	{ 0x54024a6a6b0b3ce1ULL, "TANK", Platform::Modern, 9, DEFAULT_KEYMAP },
+	{ 0x5ed42bfb6a0610a0ULL, "XO_test", Platform::XoChip, 30, DEFAULT_KEYMAP },
+	{ 0x68fe0a18de1ce0a3ULL, "test_opcode", Platform::Modern, 30, DEFAULT_KEYMAP },
+	{ 0x6d9a815f183b77e4ULL, "CONNECT4", Platform::Modern, 9, DEFAULT_KEYMAP },
+	{ 0x73eab3fb89c0d6d3ULL, "BLITZ", Platform::Chip48, 12, DEFAULT_KEYMAP },
+	{ 0x85652bcc92e412c0ULL, "PONG", Platform::Modern, 9, DEFAULT_KEYMAP },
+	{ 0x8b9be364d5aa9203ULL, "MERLIN", Platform::Modern, 9, DEFAULT_KEYMAP },
+	{ 0x8c9a5f6a465850f8ULL, "UFO", Platform::Modern, 9, DEFAULT_KEYMAP },
+	{ 0x902dfdb688b32142ULL, "SYZYGY", Platform::Modern, 15, DEFAULT_KEYMAP },
+	{ 0x95e3b2b2ef73ea34ULL, "c8_test", Platform::Modern, 30, DEFAULT_KEYMAP },
+	{ 0xc46ca389cecf0734ULL, "15PUZZLE", Platform::Modern, 9, DEFAULT_KEYMAP },
+	{ 0xd828ac742fbb24c0ULL, "VBRIX", Platform::Chip48, 12, DEFAULT_KEYMAP },
+	{ 0xde78b5b99d7f6640ULL, "MAZE", Platform::Vip, 9, DEFAULT_KEYMAP },
+	{ 0xe3529eae9aa23e62ULL, "HIDDEN", Platform::Modern, 9, DEFAULT_KEYMAP },
+	{ 0xe6588253bf781296ULL, "SCTEST", Platform::SuperChip, 30, DEFAULT_KEYMAP },
+	{ 0xe9322020b823e5a7ULL, "BLINKY", Platform::Modern, 15, DEFAULT_KEYMAP },
+	{ 0xf5f9daea143c12f6ULL, "WIPEOFF", Platform::Modern, 9, DEFAULT_KEYMAP },
+	{ 0xfde949f8fa517a80ULL, "PUZZLE", Platform::Modern, 9, DEFAULT_KEYMAP },
+};
+
+static const RomInfo unknownRom = { 0, nullptr, Platform::Modern, DEFAULT_CYCLES_PER_FRAME, DEFAULT_KEYMAP };
+
+const RomInfo& findRom(uint64_t hash)
+{
+	const RomInfo* end = std::end(database);
+	const RomInfo* it = std::lower_bound(std::begin(database), end, hash,
+		[](const RomInfo& info, uint64_t h) { return info.hash < h; });
+	if (it != end && it->hash == hash)
+		return *it;
+	return unknownRom;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include "Platform.h"
+
+#define DEFAULT_CYCLES_PER_FRAME 9
+#define DEFAULT_KEYMAP "x123qweasdzc4rfv"
+
+/*
+ * Configuration of a known ROM, identified by the XXH64 hash of its image.
+ * The platform selects the interpreter and therefore the quirks the ROM expects (see Platform.h).
+*/
+struct RomInfo
+{
+	uint64_t hash;
+	const char* name;
+	Platform platform;
+	int cyclesPerFrame; // Instructions executed per 60 Hz frame
+	/*
+	 * Host key of each CHIP-8 key 0x0-0xF, as the lowercase character printed on the keyboard.
+	 * The default maps the hex keypad to the left side of a QWERTY keyboard:
+	 *     1 2 3 C      1 2 3 4
+	 *     4 5 6 D  ->  Q W E R
+	 *     7 8 9 E      A S D F
+	 *     A 0 B F      Z X C V
+	*/
+	const char* keymap;
+};
+
+/*
+ * Look up a ROM in the embedded database.
+ * Unknown ROMs get a default configuration with a hash of 0 and no name.
+*/
+const RomInfo& findRom(uint64_t hash);
@@ -0,0 +1,156 @@
+#include "RomImage.h"
+#include "Chip8.h"
+#include "Hash.h"
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#define PAGE_CHUNK 64 // Pages allocated at once when the free list is empty, the first one holds the reference counts
+#define CHUNK_SIZE (PAGE_CHUNK * MEM_PAGE_SIZE) // Chunks are aligned to their size to find the counts of a page
+
+const unsigned char RomImage::zeroPage[MEM_PAGE_SIZE] = {};
+
+static std::mutex imageLock;
+static std::unordered_multimap<uint64_t, RomImage*> images;
+
+const RomImage* RomImage::get(std::span<const uint8_t> rom, uint64_t hash)
+{
+	std::lock_guard<std::mutex> guard(imageLock);
+	auto range = images.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		RomImage* image = it->second;
+		if (image->size == rom.size() && (rom.empty() || memcmp(&image->data[APP_DATA], rom.data(), rom.size()) == 0))
+		{
+			image->refs.fetch_add(1, std::memory_order_relaxed);
+			return image;
+		}
+	}
+
+	RomImage* image = new RomImage();
+	image->hash = hash;
+	image->size = rom.size();
+	image->pageCount = (unsigned int)((APP_DATA + rom.size() + MEM_PAGE_MASK) >> MEM_PAGE_SHIFT);
+	image->data.reset(new unsigned char[image->pageCount << MEM_PAGE_SHIFT]());
+	memcpy(&image->data[FONT_ADDR], Chip8::chip8_fontset, sizeof(Chip8::chip8_fontset));
+	memcpy(&image->data[BIGFONT_ADDR], Chip8::schip_bigfontset, sizeof(Chip8::schip_bigfontset));
+	if (!rom.empty())
+		memcpy(&image->data[APP_DATA], rom.data(), rom.size());
+	for (unsigned int addr = 0; addr < image->pageCount << MEM_PAGE_SHIFT; addr++)
+		image->memHash ^= memoryKey(addr, image->data[addr]);
+	images.emplace(hash, image);
+	return image;
+}
+
+void RomImage::retain(const RomImage* image)
+{
+	if (image)
+		image->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RomImage::release(const RomImage* image)
+{
+	if (!image)
+		return;
+
+	// Only the last reference is dropped under the lock, so get() never hands out an image being freed
+	uint32_t refs = image->refs.load(std::memory_order_relaxed);
+	while (refs > 1)
+		if (image->refs.compare_exchange_weak(refs, refs - 1, std::memory_order_acq_rel))
+			return;
+
+	std::lock_guard<std::mutex> guard(imageLock);
+	if (image->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		return;
+	auto range = images.equal_range(image->hash);
+	for (auto it = range.first; it != range.second; ++it)
+		if (it->second == image)
+		{
+			images.erase(it);
+			break;
+		}
+	delete image;
+}
+
+/*
+ * Free pages are linked through their first bytes
+*/
+struct FreePage
+{
+	FreePage* next;
+};
+
+/*
+ * Chunks are never returned while running, their pages go back to the free list
+*/
+struct PageChunks
+{
+	std::vector<unsigned char*> chunks;
+
+	~PageChunks()
+	{
+		for (unsigned char* chunk : chunks)
+			::operator delete[](chunk, std::align_val_t(CHUNK_SIZE));
+	}
+};
+
+static std::mutex pageLock;
+static FreePage* freePages = nullptr;
+static PageChunks pageChunks;
+
+static std::atomic<uint32_t>& refCount(const unsigned char* page)
+{
+	uintptr_t offset = (uintptr_t)page & (CHUNK_SIZE - 1);
+	std::atomic<uint32_t>* counts = (std::atomic<uint32_t>*)(page - offset);
+	return counts[(offset >> MEM_PAGE_SHIFT) - 1];
+}
+
+unsigned char* allocPage()
+{
+	FreePage* page;
+	{
+		std::lock_guard<std::mutex> guard(pageLock);
+		if (!freePages)
+		{
+			unsigned char* chunk = (unsigned char*)::operator new[](CHUNK_SIZE, std::align_val_t(CHUNK_SIZE));
+			pageChunks.chunks.push_back(chunk);
+			for (int i = 0; i < PAGE_CHUNK - 1; i++)
+				new (&((std::atomic<uint32_t>*)chunk)[i]) std::atomic<uint32_t>(0);
+			for (int i = 1; i < PAGE_CHUNK; i++)
+			{
+				FreePage* free = (FreePage*)&chunk[i * MEM_PAGE_SIZE];
+				free->next = freePages;
+				freePages = free;
+			}
+		}
+		page = freePages;
+		freePages = page->next;
+	}
+	refCount((unsigned char*)page).store(1, std::memory_order_relaxed);
+	return (unsigned char*)page;
+}
+
+void retainPage(const unsigned char* page, unsigned int n)
+{
+	refCount(page).fetch_add(n, std::memory_order_relaxed);
+}
+
+void releasePage(const unsigned char* page)
+{
+	// The last owner frees the page once every other owner is done with it
+	if (refCount(page).fetch_sub(1, std::memory_order_acq_rel) != 1)
+		return;
+
+	std::lock_guard<std::mutex> guard(pageLock);
+	FreePage* free = (FreePage*)page;
+	free->next = freePages;
+	freePages = free;
+}
+
+bool pageShared(const unsigned char* page)
+{
+	return refCount(page).load(std::memory_order_acquire) > 1;
+}
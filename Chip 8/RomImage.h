@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+#define MEM_PAGE_SHIFT 8
+#define MEM_PAGE_SIZE (1 << MEM_PAGE_SHIFT) // 256 bytes
+#define MEM_PAGE_MASK (MEM_PAGE_SIZE - 1)
+#define MAX_PAGES (65536 / MEM_PAGE_SIZE) // Pages of the largest memory (XO-CHIP)
+#define APP_DATA 512 // 0x200 in memory
+
+/*
+ * Read-only initial memory of a ROM: the fontsets, then the ROM at 0x200.
+ * One image is built per ROM and shared by every Chip8 running it, the instances only copy the
+ * pages they write to (see Chip8::write). Pages past the end of the image are all zeros and
+ * share a single zero page.
+ * Images are reference counted, each Chip8 holds a reference to the one it maps and the last one
+ * to let go of an image frees it.
+*/
+struct RomImage
+{
+	uint64_t hash = 0;
+	uint64_t memHash = 0; // Incremental hash of the memory (see memoryKey)
+	size_t size = 0; // Of the ROM, at APP_DATA
+	unsigned int pageCount = 0;
+	std::unique_ptr<unsigned char[]> data;
+	mutable std::atomic<uint32_t> refs = 1;
+
+	const unsigned char* page(unsigned int p) const
+	{
+		return p < pageCount ? &data[p << MEM_PAGE_SHIFT] : zeroPage;
+	}
+
+	/*
+	 * Image of a ROM with one reference for the caller, built the first time it is requested.
+	 * The hash finds the image, the bytes are compared so two ROMs with the same hash get their own. Thread safe.
+	*/
+	static const RomImage* get(std::span<const uint8_t> rom, uint64_t hash);
+
+	/*
+	 * Take another reference to an image the caller already holds one to, or drop one. Null is ignored.
+	*/
+	static void retain(const RomImage* image);
+	static void release(const RomImage* image);
+
+	static const unsigned char zeroPage[MEM_PAGE_SIZE];
+};
+
+/*
+ * Private pages of the instances.
+ * Pages are carved from large chunks and recycled through a free list, so a copy on write doesn't go
+ * through the heap. They are reference counted so clones can share them (see Chip8::cloneInto).
+ * Thread safe.
+*/
+unsigned char* allocPage(); // With one reference
+void retainPage(const unsigned char* page, unsigned int n = 1);
+void releasePage(const unsigned char* page); // Back to the free list with the last reference
+bool pageShared(const unsigned char* page); // More than one reference
@@ -0,0 +1,158 @@
+#include "RomPack.h"
+#include "Hash.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+bool RomPack::open(const char* path)
+{
+	count = 0;
+	if (!file.open(path))
+		return false;
+
+	std::span<const uint8_t> bytes = file.bytes();
+	if (bytes.size() < sizeof(RomPackHeader))
+		return false;
+
+	RomPackHeader header;
+	memcpy(&header, bytes.data(), sizeof(header));
+	if (memcmp(header.magic, ROMPACK_MAGIC, sizeof(header.magic)) != 0 || header.version != ROMPACK_VERSION)
+		return false;
+
+	// Check every section is inside the file before using it in place
+	uint64_t entriesEnd = sizeof(RomPackHeader) + (uint64_t)header.count * sizeof(RomPackEntry);
+	if (entriesEnd > header.nameIndexOffset
+		|| header.nameIndexOffset + (uint64_t)header.count * sizeof(uint32_t) > header.namesOffset
+		|| header.namesOffset > header.payloadOffset
+		|| header.payloadOffset + (uint64_t)header.payloadSize > bytes.size())
+		return false;
+
+	entries = (const RomPackEntry*)(bytes.data() + sizeof(RomPackHeader));
+	nameIndex = (const uint32_t*)(bytes.data() + header.nameIndexOffset);
+	names = (const char*)(bytes.data() + header.namesOffset);
+	payload = bytes.data() + header.payloadOffset;
+
+	uint64_t namesSize = header.payloadOffset - header.namesOffset;
+	for (uint32_t i = 0; i < header.count; i++)
+	{
+		const RomPackEntry& e = entries[i];
+		if ((uint64_t)e.offset + e.size > header.payloadSize
+			|| (uint64_t)e.nameOffset + e.nameLength > namesSize
+			|| nameIndex[i] >= header.count)
+			return false;
+	}
+
+	count = header.count;
+	return true;
+}
+
+RomPack::Rom RomPack::at(uint32_t index) const
+{
+	const RomPackEntry& e = entries[index];
+	Rom rom;
+	rom.name = std::string_view(names + e.nameOffset, e.nameLength);
+	rom.hash = e.hash;
+	rom.image = std::span<const uint8_t>(payload + e.offset, e.size);
+	return rom;
+}
+
+bool RomPack::find(uint64_t hash, Rom& rom) const
+{
+	const RomPackEntry* end = entries + count;
+	const RomPackEntry* it = std::lower_bound(entries, end, hash,
+		[](const RomPackEntry& e, uint64_t h) { return e.hash < h; });
+	if (it == end || it->hash != hash)
+		return false;
+	rom = at((uint32_t)(it - entries));
+	return true;
+}
+
+bool RomPack::find(std::string_view name, Rom& rom) const
+{
+	const uint32_t* end = nameIndex + count;
+	const uint32_t* it = std::lower_bound(nameIndex, end, name,
+		[this](uint32_t i, std::string_view n) { return at(i).name < n; });
+	if (it == end || at(*it).name != name)
+		return false;
+	rom = at(*it);
+	return true;
+}
+
+bool RomPack::lookup(std::string_view nameOrHash, Rom& rom) const
+{
+	if (find(nameOrHash, rom))
+		return true;
+	std::string digits(nameOrHash);
+	char* end = nullptr;
+	uint64_t hash = strtoull(digits.c_str(), &end, 16);
+	return !digits.empty() && !*end && find(hash, rom);
+}
+
+bool RomPack::build(const char* path, const std::vector<std::pair<std::string, std::vector<uint8_t>>>& roms)
+{
+	uint32_t count = (uint32_t)roms.size();
+	std::vector<RomPackEntry> entries(count);
+	std::string names;
+	std::vector<uint8_t> payload;
+	std::unordered_multimap<uint64_t, uint32_t> stored; // Entry of the first ROM of each distinct image, by hash
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const std::string& name = roms[i].first;
+		const std::vector<uint8_t>& image = roms[i].second;
+		RomPackEntry& e = entries[i];
+		e.hash = xxhash64(image.data(), image.size());
+		e.size = (uint32_t)image.size();
+		e.nameOffset = (uint32_t)names.size();
+		e.nameLength = (uint32_t)name.size();
+		names += name;
+
+		// Deduplicate identical images, the bytes are compared so two ROMs with the same hash are both stored
+		e.offset = (uint32_t)payload.size();
+		auto range = stored.equal_range(e.hash);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			const RomPackEntry& same = entries[it->second];
+			if (same.size == e.size && (e.size == 0 || memcmp(&payload[same.offset], image.data(), e.size) == 0))
+			{
+				e.offset = same.offset;
+				break;
+			}
+		}
+		if (e.offset == payload.size())
+		{
+			stored.emplace(e.hash, i);
+			payload.insert(payload.end(), image.begin(), image.end());
+		}
+	}
+
+	// Hash index, and the name index over it
+	std::sort(entries.begin(), entries.end(), [](const RomPackEntry& a, const RomPackEntry& b) { return a.hash < b.hash; });
+	std::vector<uint32_t> nameIndex(count);
+	for (uint32_t i = 0; i < count; i++)
+		nameIndex[i] = i;
+	std::sort(nameIndex.begin(), nameIndex.end(), [&](uint32_t a, uint32_t b)
+		{
+			return names.compare(entries[a].nameOffset, entries[a].nameLength, names, entries[b].nameOffset, entries[b].nameLength) < 0;
+		});
+
+	RomPackHeader header;
+	memcpy(header.magic, ROMPACK_MAGIC, sizeof(header.magic));
+	header.version = ROMPACK_VERSION;
+	header.count = count;
+	header.nameIndexOffset = (uint32_t)(sizeof(RomPackHeader) + count * sizeof(RomPackEntry));
+	header.namesOffset = header.nameIndexOffset + count * (uint32_t)sizeof(uint32_t);
+	header.payloadOffset = header.namesOffset + (uint32_t)names.size();
+	header.payloadSize = (uint32_t)payload.size();
+
+	std::ofstream out(path, std::ios::binary);
+	out.write((const char*)&header, sizeof(header));
+	out.write((const char*)entries.data(), count * sizeof(RomPackEntry));
+	out.write((const char*)nameIndex.data(), count * sizeof(uint32_t));
+	out.write(names.data(), names.size());
+	out.write((const char*)payload.data(), payload.size());
+	out.close();
+	return !out.fail();
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "MappedFile.h"
+
+#define ROMPACK_MAGIC "CHIP8PAK"
+#define ROMPACK_VERSION 1
+
+/*
+ * Archive of many ROMs in a single file, built with chip8-pack.
+ *
+ * Layout (little endian):
+ *     RomPackHeader
+ *     RomPackEntry[count]     sorted by hash, one per ROM name
+ *     uint32_t[count]         entry indices sorted by name
+ *     names                   concatenated, not terminated
+ *     payload                 concatenated ROM images, identical images are stored once
+ *
+ * The archive is memory mapped and the ROM images are used in place, loading one is a single
+ * copy into the Chip8 memory with Chip8::loadProgram(std::span).
+*/
+struct RomPackHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t count;
+	uint32_t nameIndexOffset;
+	uint32_t namesOffset;
+	uint32_t payloadOffset;
+	uint32_t payloadSize;
+};
+
+struct RomPackEntry
+{
+	uint64_t hash; // XXH64 of the image, the same hash as the ROM database
+	uint32_t offset; // In the payload
+	uint32_t size;
+	uint32_t nameOffset; // In the names
+	uint32_t nameLength;
+};
+
+class RomPack
+{
+public:
+	struct Rom
+	{
+		std::string_view name;
+		uint64_t hash = 0;
+		std::span<const uint8_t> image;
+	};
+
+	/*
+	 * Map and validate an archive
+	*/
+	bool open(const char* path);
+
+	/*
+	 * Number of ROMs, ROMs are indexed in hash order
+	*/
+	uint32_t size() const { return count; }
+	Rom at(uint32_t index) const;
+
+	/*
+	 * Find a ROM with a binary search in the indexes. Returns false if it is not in the archive.
+	*/
+	bool find(uint64_t hash, Rom& rom) const;
+	bool find(std::string_view name, Rom& rom) const;
+
+	/*
+	 * Find a ROM by its name, or else by the hexadecimal hash of its image as chip8-pack -l lists it
+	*/
+	bool lookup(std::string_view nameOrHash, Rom& rom) const;
+
+	/*
+	 * Write an archive with the given ROMs. Returns false if the file can't be written.
+	*/
+	static bool build(const char* path, const std::vector<std::pair<std::string, std::vector<uint8_t>>>& roms);
+
+private:
+	MappedFile file;
+	uint32_t count = 0;
+	const RomPackEntry* entries = nullptr;
+	const uint32_t* nameIndex = nullptr;
+	const char* names = nullptr;
+	const uint8_t* payload = nullptr;
+};
@@ -0,0 +1,137 @@
+#include "Tracer.h"
+#include "Interpreter.h"
+#include <algorithm>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+
+static Tracer* crashTracer = nullptr; // Dumped by the crash handler
+
+/*
+ * Write the trace and crash again with the default handler.
+ * Writing a file is not async signal safe, but the process is going down anyway and the trace is what's
+ * needed to find out why.
+*/
+static void onCrash(int signal)
+{
+	if (crashTracer && crashTracer->dumpPath)
+		crashTracer->dump(crashTracer->dumpPath, TraceReason::Crash);
+	std::signal(signal, SIG_DFL);
+	std::raise(signal);
+}
+
+Tracer::~Tracer()
+{
+	if (crashTracer == this)
+		crashTracer = nullptr;
+}
+
+void Tracer::run(Chip8& c, int cycles)
+{
+	romHash = c.romHash;
+	platform = c.platform;
+	withPlatform(c.platform, [&](auto p)
+		{
+			Interpreter<decltype(p), Tracer>::run(c, cycles, *this);
+		});
+}
+
+void Tracer::setTrigger(const TraceTrigger& newTrigger)
+{
+	trigger = newTrigger;
+	armed = true;
+	stopAt = UINT64_MAX;
+	updateSlowAt();
+}
+
+void Tracer::updateSlowAt()
+{
+	// Every record is matched while the trigger is armed
+	slowAt = armed ? 0 : std::min(stopAt, dumpAt - 1);
+}
+
+void Tracer::slowPath(const Chip8& c, unsigned short pc, unsigned short opcode)
+{
+	uint64_t n = head.load(std::memory_order_relaxed);
+	if (n >= stopAt)
+		return;
+	record(n, c, pc, opcode);
+
+	if (armed && (pc & trigger.pcMask) == trigger.pc && (opcode & trigger.opcodeMask) == trigger.opcode)
+	{
+		armed = false;
+		stopAt = n + 1 + trigger.after;
+		dumpAt = stopAt;
+		dumpReason = TraceReason::Trigger;
+	}
+	if (n + 1 == dumpAt)
+	{
+		dumpAt = UINT64_MAX;
+		if (dumpPath)
+			dump(dumpPath, dumpReason);
+	}
+	updateSlowAt();
+}
+
+void Tracer::unknownOpcode(const Chip8& c)
+{
+	// Dump once the unknown opcode itself is recorded
+	if (dumpedUnknown || dumpAt != UINT64_MAX)
+		return;
+	dumpedUnknown = true;
+	dumpAt = head.load(std::memory_order_relaxed) + 1;
+	dumpReason = TraceReason::UnknownOpcode;
+	updateSlowAt();
+}
+
+std::vector<TraceRecord> Tracer::records(uint64_t& firstCycle) const
+{
+	uint64_t end = head.load(std::memory_order_acquire);
+	uint64_t begin = end >= TRACE_CAPACITY ? end - TRACE_CAPACITY + 1 : 0; // The oldest slot is the next one written
+	std::vector<TraceRecord> copy;
+	copy.reserve((size_t)(end - begin));
+	for (uint64_t n = begin; n < end; n++)
+		copy.push_back(ring[n & (TRACE_CAPACITY - 1)]);
+
+	// The writer may have gone on while copying, drop the records it reused
+	uint64_t now = head.load(std::memory_order_acquire);
+	uint64_t overwritten = now >= TRACE_CAPACITY ? now - TRACE_CAPACITY + 1 : 0; // The record being written reuses the slot of now - TRACE_CAPACITY
+	if (overwritten > begin)
+	{
+		uint64_t dropped = std::min(overwritten - begin, (uint64_t)copy.size());
+		copy.erase(copy.begin(), copy.begin() + (size_t)dropped);
+		begin += dropped;
+	}
+	firstCycle = begin;
+	return copy;
+}
+
+bool Tracer::dump(const char* path, TraceReason reason) const
+{
+	uint64_t firstCycle;
+	std::vector<TraceRecord> copy = records(firstCycle);
+
+	TraceHeader header;
+	memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+	header.version = TRACE_VERSION;
+	header.count = (uint32_t)copy.size();
+	header.romHash = romHash;
+	header.firstCycle = firstCycle;
+	header.platform = (uint32_t)platform;
+	header.reason = (uint32_t)reason;
+
+	std::ofstream out(path, std::ios::binary);
+	out.write((const char*)&header, sizeof(header));
+	out.write((const char*)copy.data(), copy.size() * sizeof(TraceRecord));
+	out.close();
+	return !out.fail();
+}
+
+void Tracer::dumpOnCrash()
+{
+	crashTracer = this;
+	std::signal(SIGSEGV, onCrash);
+	std::signal(SIGABRT, onCrash);
+	std::signal(SIGILL, onCrash);
+	std::signal(SIGFPE, onCrash);
+}
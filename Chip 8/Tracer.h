@@ -0,0 +1,169 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "Chip8.h"
+#include "Hooks.h"
+
+#define TRACE_MAGIC "CHIP8TRC"
+#define TRACE_VERSION 1
+#define TRACE_CAPACITY 4096 // Records in the ring, a power of two (32 KB)
+
+/*
+ * Why a trace was written
+*/
+enum class TraceReason : uint32_t
+{
+	Requested,
+	Trigger, // The trigger instruction was executed (see TraceTrigger)
+	UnknownOpcode,
+	Crash
+};
+
+/*
+ * Trace file, written by Tracer::dump() and decoded by chip8-trace.
+ *
+ * Layout (little endian):
+ *     TraceHeader
+ *     TraceRecord[count]      oldest first
+*/
+struct TraceHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t count;
+	uint64_t romHash;
+	uint64_t firstCycle; // Instructions traced before the first record
+	uint32_t platform; // Platform of the interpreter, to disassemble the opcodes
+	uint32_t reason; // TraceReason
+};
+
+/*
+ * One executed instruction. The register most instructions change is VX, it is recorded with VF and I
+ * as they were after the instruction.
+*/
+struct TraceRecord
+{
+	uint16_t pc;
+	uint16_t opcode;
+	uint16_t I;
+	uint8_t vx; // VX of the opcode
+	uint8_t vf;
+};
+
+static_assert(sizeof(TraceRecord) == 8, "Trace records are written as is");
+static_assert((TRACE_CAPACITY & (TRACE_CAPACITY - 1)) == 0, "The ring is indexed with a mask");
+
+/*
+ * Instruction that stops the trace: (pc & pcMask) == pc and (opcode & opcodeMask) == opcode.
+ * The trace stops after more instructions, so it keeps what led to the instruction and what followed.
+*/
+struct TraceTrigger
+{
+	uint16_t pcMask = 0;
+	uint16_t pc = 0;
+	uint16_t opcodeMask = 0;
+	uint16_t opcode = 0;
+	unsigned int after = 0;
+};
+
+/*
+ * Execution trace of the last instructions, cheap enough to stay on while playing: a record is a few stores,
+ * 10 to 20% of the emulation time of a busy program, and a program waiting in place is recorded once per wait.
+ * The tracer is the hooks of its own specialization of the interpreter (see Interpreter.h): run the
+ * program with Tracer::run() instead of Chip8::run() to trace it.
+ * Each instruction is one record in a ring buffer. The emulator thread is the only writer, it publishes
+ * each record with a release store of the head, so another thread can read the ring without locks.
+*/
+class Tracer : public NoHooks
+{
+public:
+	~Tracer();
+
+	/*
+	 * Execute several cycles with the tracing interpreter of the platform
+	*/
+	void run(Chip8& c, int cycles);
+
+	/*
+	 * Stop the trace on an instruction, replacing the previous trigger.
+	 * The trace is written to dumpPath when it stops.
+	*/
+	void setTrigger(const TraceTrigger& newTrigger);
+
+	/*
+	 * The trigger has stopped the trace
+	*/
+	bool stopped() const { return stopAt != UINT64_MAX && head.load(std::memory_order_acquire) >= stopAt; }
+
+	/*
+	 * Records in the ring, oldest first, and the number of instructions traced before the first one.
+	 * From another thread, the records overwritten while copying are left out.
+	*/
+	std::vector<TraceRecord> records(uint64_t& firstCycle) const;
+
+	/*
+	 * Write the records to a trace file. Returns false if the file can't be written.
+	*/
+	bool dump(const char* path, TraceReason reason) const;
+
+	/*
+	 * Write the trace to dumpPath if the process crashes (segmentation fault, abort, illegal instruction).
+	 * Only one tracer at a time.
+	*/
+	void dumpOnCrash();
+
+	const char* dumpPath = nullptr; // Written on the first unknown opcode, on the trigger and on crashes
+
+	/*
+	 * Hooks of the interpreter
+	*/
+	void executed(const Chip8& c, unsigned short pc, unsigned short opcode)
+	{
+		uint64_t n = head.load(std::memory_order_relaxed);
+		if (n >= slowAt) // Stopped, trigger armed or dump pending
+			slowPath(c, pc, opcode);
+		else
+			record(n, c, pc, opcode);
+	}
+	void idle(const Chip8& c, int cycles)
+	{
+		// One record for the whole wait, unless a trigger or a dump counts the records
+		uint64_t n = head.load(std::memory_order_relaxed);
+		const TraceRecord& last = ring[(n - 1) & (TRACE_CAPACITY - 1)];
+		if (n == 0 || slowAt != UINT64_MAX || last.pc != c.pc || last.opcode != c.opcode)
+			executed(c, c.pc, c.opcode);
+	}
+	void unknownOpcode(const Chip8& c);
+
+private:
+	void record(uint64_t n, const Chip8& c, unsigned short pc, unsigned short opcode)
+	{
+		// Packed in a register in the little endian layout of TraceRecord, and stored at once
+		uint64_t packed = pc | (uint64_t)opcode << 16 | (uint64_t)c.I << 32 | (uint64_t)c.V[(opcode >> 8) & 0xF] << 48 | (uint64_t)c.V[0xF] << 56;
+		memcpy(&ring[n & (TRACE_CAPACITY - 1)], &packed, sizeof(packed));
+		head.store(n + 1, std::memory_order_release);
+	}
+	void slowPath(const Chip8& c, unsigned short pc, unsigned short opcode);
+	void updateSlowAt();
+
+	/*
+	 * The last TRACE_CAPACITY - 1 instructions, the oldest slot is the one being written.
+	 * The size is fixed so recording doesn't load the address and the size of the ring.
+	*/
+	TraceRecord ring[TRACE_CAPACITY];
+	std::atomic<uint64_t> head{ 0 }; // Records written so far
+	TraceTrigger trigger;
+	bool armed = false;
+	uint64_t stopAt = UINT64_MAX; // Records written when the trace stops
+	uint64_t dumpAt = UINT64_MAX; // Records written when the pending dump is done
+	uint64_t slowAt = UINT64_MAX; // Records written when the next record needs the slow path
+	TraceReason dumpReason = TraceReason::Requested;
+	bool dumpedUnknown = false; // Only the first unknown opcode is dumped
+
+	// Running ROM, for the trace file
+	uint64_t romHash = 0;
+	Platform platform = Platform::SuperChip;
+};
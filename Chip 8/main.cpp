@@ -3,13 +3,25 @@
 #include <SDL_mixer.h>
 #include <stdio.h>
 #include <string>
+#include <chrono>
 #include <cmath>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <vector>
 #include "Chip8.h"
+#include "Audio.h"
+#include "Debugger.h"
+#include "Histogram.h"
+#include "Overlay.h"
+#include "Profiler.h"
+#include "Tracer.h"
 
-//Screen dimension constants (10x chip8 resolution)
-#define SCREEN_WIDTH WIDTH*10
-#define SCREEN_HEIGHT HEIGHT*10
+//Screen dimension constants (10x chip8 resolution, 5x SUPER-CHIP resolution)
+#define SCREEN_WIDTH HIRES_WIDTH*5
+#define SCREEN_HEIGHT HIRES_HEIGHT*5
 
 //Starts up SDL and creates window
 bool init(SDL_Window** window, SDL_Renderer** renderer);
@@ -17,11 +29,115 @@ bool init(SDL_Window** window, SDL_Renderer** renderer);
 //Frees media and shuts down SDL
 void close(SDL_Window** window, SDL_Renderer** renderer);
 
+// Colors of the pixels, indexed by the XO-CHIP planes (plane1 << 1 | plane0)
+static const SDL_Color palette[4] =
+{
+	{ 0xFF, 0xFF, 0xFF, 0xFF }, // Background
+	{ 0xFF, 0x00, 0x00, 0xFF }, // Plane 0, the only one in CHIP-8 and SUPER-CHIP
+	{ 0x00, 0x00, 0xFF, 0xFF }, // Plane 1
+	{ 0x00, 0x00, 0x00, 0xFF }  // Both planes
+};
+
+/*
+ * Where the time of a frame goes, in nanoseconds
+*/
+struct FrameTimes
+{
+	Histogram emulation; // Running the cycles of the frame
+	Histogram render; // Drawing the screen and the overlay
+	Histogram present; // SDL_RenderPresent, with the wait for the vertical sync
+	Histogram input; // From a key event to the present of the first frame that emulated it
+
+	void write(std::ostream& out) const
+	{
+		emulation.write(out, "Emulation");
+		render.write(out, "Render");
+		present.write(out, "Present");
+		input.write(out, "Input to present");
+	}
+};
+
 // Handles key presses
-void handleEvent(SDL_Event* e, Chip8* chip8);
+void handleEvent(SDL_Event* e, Chip8* chip8, const char* keymap);
+
+// Debugger keys: F5 continue/pause, F9 breakpoint at the pc, F10 step over, F11 step. Returns false for other keys.
+bool debugHotkey(SDL_Keycode key, Debugger& debugger, const Chip8& chip8);
+
+// Percentiles of the frame times, a line per histogram
+std::vector<std::string> frameTimesOverlay(const FrameTimes& times);
+
+// Fills the SDL_mixer output with the XO-CHIP audio pattern (audio thread)
+void mixAudio(void* udata, Uint8* stream, int len);
 
 int main(int argc, char* args[])
 {
+	// ROM to run, the rest of the configuration comes from the ROM database
+	const char* rom = "../roms/PONG";
+	const char* profilePath = nullptr; // Collapsed stacks of the profile, written on exit (see Profiler.h)
+	const char* tracePath = nullptr; // Trace of the last instructions, written on unknown opcodes and crashes (see Tracer.h)
+	int traceAt = -1; // Address that stops the trace
+	const char* latencyPath = nullptr; // Frame time histograms, written on exit
+	bool debug = false; // Run under the debugger, paused on the first instruction
+	std::vector<int> breakAt; // Breakpoints of the debugger
+	UnknownOpcodePolicy unknownOpcodes = UnknownOpcodePolicy::Halt;
+	std::optional<Platform> platform; // Instead of the one of the ROM database
+	for (int i = 1; i < argc; i++)
+	{
+		Platform named;
+		if (strcmp(args[i], "--profile") == 0 && i + 1 < argc)
+			profilePath = args[++i];
+		else if (strcmp(args[i], "--trace") == 0 && i + 1 < argc)
+			tracePath = args[++i];
+		else if (strcmp(args[i], "--trace-at") == 0 && i + 1 < argc)
+			traceAt = (int)strtol(args[++i], nullptr, 16);
+		else if (strcmp(args[i], "--skip-unknown") == 0) // Go on after unknown opcodes instead of halting
+			unknownOpcodes = UnknownOpcodePolicy::Skip;
+		else if (strcmp(args[i], "--latency") == 0 && i + 1 < argc)
+			latencyPath = args[++i];
+		else if (strcmp(args[i], "--debug") == 0)
+			debug = true;
+		else if (strcmp(args[i], "--break") == 0 && i + 1 < argc)
+			breakAt.push_back((int)strtol(args[++i], nullptr, 16));
+		else if (strcmp(args[i], "--platform") == 0 && i + 1 < argc)
+		{
+			if (parsePlatform(args[++i], named))
+				platform = named;
+			else
+				printf("Unknown platform %s, expected vip, chip48, modern, schip or xochip\n", args[i]);
+		}
+		else
+			rom = args[i];
+	}
+	std::unique_ptr<Profiler> profiler(profilePath ? new Profiler() : nullptr);
+
+	// The debugger runs the program instead of the tracer, from the first instruction or until a breakpoint
+	std::unique_ptr<Debugger> debugger(debug || !breakAt.empty() ? new Debugger() : nullptr);
+	if (debugger)
+	{
+		for (int addr : breakAt)
+			debugger->setBreakpoint(addr);
+		if (breakAt.empty())
+			debugger->pause();
+	}
+
+	// Tracing costs 10 to 20% of the emulation time of a busy program, it is only on when asked for
+	if (traceAt >= 0 && !tracePath)
+		tracePath = "chip8.trace";
+	std::unique_ptr<Tracer> tracer(tracePath ? new Tracer() : nullptr);
+	if (tracer)
+	{
+		tracer->dumpPath = tracePath;
+		tracer->dumpOnCrash();
+	}
+	if (tracer && traceAt >= 0)
+	{
+		TraceTrigger trigger;
+		trigger.pcMask = 0xFFFF;
+		trigger.pc = (uint16_t)traceAt;
+		trigger.after = TRACE_CAPACITY / 2;
+		tracer->setTrigger(trigger);
+	}
+
 	//The window we'll be rendering to
 	SDL_Window* window = NULL;
 
@@ -41,14 +157,23 @@ int main(int argc, char* args[])
 		//Event handler
 		SDL_Event e;
 
+		// Frame times, shown with F1
+		using clock = std::chrono::steady_clock;
+		std::unique_ptr<FrameTimes> times(new FrameTimes());
+		bool overlay = false;
+		bool inputPending = false; // A key event waits for its frame to be presented
+		clock::time_point inputAt;
+
 		// Create chip8 object
 		Chip8 chip8 = Chip8();
 
 		// Initialize chip8
+		chip8.unknownOpcodePolicy = unknownOpcodes;
 		chip8.initialize();
 
 		// Set resolution scale
-		SDL_RenderSetLogicalSize(renderer, WIDTH, HEIGHT);
+		SDL_RenderSetLogicalSize(renderer, chip8.width, chip8.height);
+		int logicalWidth = chip8.width;
 
 		//Clear screen
 		SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xFF);
@@ -61,8 +186,21 @@ int main(int argc, char* args[])
 			std::cout << "Failed to load beep sound! SDL_mixer Error: " << Mix_GetError() << std::endl;
 		}
 
-		if (chip8.loadProgram("../roms/PONG")) // TODO: better rom selection
+		// Hook the XO-CHIP pattern mixer, it only supports signed 16 bit samples
+		AudioMixer mixer;
+		int rate, channels;
+		Uint16 format;
+		if (Mix_QuerySpec(&rate, &format, &channels) != 0 && format == AUDIO_S16SYS)
+		{
+			mixer.setOutput(rate, channels);
+			Mix_HookMusic(mixAudio, &mixer);
+		}
+
+		if (chip8.loadProgram(rom, platform))
 		{
+			const RomInfo& info = *chip8.romInfo;
+			printf("%s: %s, %d cycles/frame\n", info.name ? info.name : rom, withPlatform(chip8.platform, [](auto p) { return p.name; }), info.cyclesPerFrame);
+
 			//While application is running
 			while (!quit)
 			{
@@ -74,46 +212,124 @@ int main(int argc, char* args[])
 					{
 						quit = true;
 					}
-					handleEvent(&e, &chip8);
+					if (e.type == SDL_KEYDOWN && e.key.repeat == 0)
+					{
+						if (e.key.keysym.sym == SDLK_F1)
+						{
+							overlay = !overlay;
+							chip8.drawFlag = true; // Redraw the screen under the overlay
+						}
+						else if (debugger && debugHotkey(e.key.keysym.sym, *debugger, chip8))
+							chip8.drawFlag = true;
+						else if (!inputPending)
+						{
+							inputPending = true;
+							inputAt = clock::now();
+						}
+					}
+					handleEvent(&e, &chip8, info.keymap);
 				}
 
+				// The program executed 00FD. A halted program stays on screen.
+				if (chip8.exited && !chip8.halted)
+					quit = true;
+
 				/*
 				 * The chip 8 has a ~500Hz CPU and has a refresh rate of 60Hz
 				 * 500Hz / 60Hz = 8.33 cycles/frame --> 8 cycles/frame
+				 * Known ROMs get their ideal speed from the ROM database.
 				*/
-				for (int cycles = 0; cycles < 9; cycles++)
-					chip8.emulateCycle();
+				clock::time_point frameStart = clock::now();
+				if (debugger)
+				{
+					// Print the state once on every stop
+					bool wasPaused = debugger->paused();
+					debugger->run(chip8, info.cyclesPerFrame);
+					if (debugger->paused() && !wasPaused)
+					{
+						if (!debugger->stopMessage().empty())
+							std::cout << debugger->stopMessage() << std::endl;
+						debugger->printState(chip8, std::cout);
+					}
+				}
+				else if (profiler)
+					profiler->run(chip8, info.cyclesPerFrame);
+				else if (tracer)
+					tracer->run(chip8, info.cyclesPerFrame);
+				else
+					chip8.run(info.cyclesPerFrame);
+				clock::time_point emulated = clock::now();
 
 				// If the draw flag is set, update the screen
 				if (chip8.drawFlag)
 				{
-					for (int j = 0; j < HEIGHT; j++)
-						for (int i = 0; i < WIDTH; i++)
+					// Follow the resolution changes of SUPER-CHIP programs
+					if (chip8.width != logicalWidth)
+					{
+						SDL_RenderSetLogicalSize(renderer, chip8.width, chip8.height);
+						logicalWidth = chip8.width;
+					}
+
+					for (int j = 0; j < chip8.height; j++)
+						for (int i = 0; i < chip8.width; i++)
 						{
-							if (chip8.gfx[(j * 64) + i] == 0) {
-								SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
-								SDL_RenderDrawPoint(renderer, i, j);
-							}
-							else {
-								SDL_SetRenderDrawColor(renderer, 0xFF, 0x00, 0x00, 0xFF);
-								SDL_RenderDrawPoint(renderer, i, j);
-							}
+							const SDL_Color& color = palette[chip8.getPixel(i, j)];
+							SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
+							SDL_RenderDrawPoint(renderer, i, j);
 						}
 					chip8.drawFlag = false; // The screen has been updated, disable the flag
 				}
+				if (debugger && debugger->paused())
+					drawOverlay(renderer, debugger->stateLines(chip8));
+				else if (overlay)
+					drawOverlay(renderer, frameTimesOverlay(*times));
+				clock::time_point rendered = clock::now();
+
 				//Update screen
 				SDL_RenderPresent(renderer);
+				clock::time_point presented = clock::now();
 
-				// Play sound
-				for (size_t i = 0; i < chip8.playSound; i++)
+				times->emulation.record(std::chrono::nanoseconds(emulated - frameStart).count());
+				times->render.record(std::chrono::nanoseconds(rendered - emulated).count());
+				times->present.record(std::chrono::nanoseconds(presented - rendered).count());
+				if (inputPending)
 				{
-					if (sinWave == NULL)
-						std::cout << "BEEP!\n"; // Print to console if no sound loaded
-					else
-						Mix_PlayChannel(-1, sinWave, 0);
+					times->input.record(std::chrono::nanoseconds(presented - inputAt).count());
+					inputPending = false;
+				}
+
+				// Play sound, not while the debugger holds the program
+				if (debugger && debugger->paused())
+					continue;
+				mixer.update(chip8);
+				if (!chip8.audioPatternLoaded) // The mixer plays the sound of ROMs that use an audio pattern
+				{
+					for (int i = 0; i < chip8.playSound; i++)
+					{
+						if (sinWave == NULL)
+							std::cout << "BEEP!\n"; // Print to console if no sound loaded
+						else
+							Mix_PlayChannel(-1, sinWave, 0);
+					}
 				}
 			}
 		}
+
+		// Stop the audio thread before the mixer goes out of scope
+		Mix_HookMusic(NULL, NULL);
+
+		if (profiler)
+		{
+			profiler->report(std::cout);
+			std::ofstream collapsed(profilePath);
+			profiler->writeCollapsed(collapsed);
+		}
+
+		if (latencyPath)
+		{
+			std::ofstream latency(latencyPath);
+			times->write(latency);
+		}
 	}
 
 	//Free resources and close SDL
@@ -183,51 +399,76 @@ void close(SDL_Window** window, SDL_Renderer** renderer)
 	SDL_Quit();
 }
 
-void handleEvent(SDL_Event* e, Chip8* chip8) {
-	// Check if a button is pressed
-	if (e->type == SDL_KEYDOWN && e->key.repeat == 0)
+void mixAudio(void* udata, Uint8* stream, int len)
+{
+	AudioMixer* mixer = (AudioMixer*)udata;
+	mixer->mix((int16_t*)stream, len / (int)(sizeof(int16_t) * mixer->channels()));
+}
+
+std::vector<std::string> frameTimesOverlay(const FrameTimes& times)
+{
+	// Milliseconds with 2 decimals
+	auto ms = [](uint64_t ns)
+	{
+		std::string decimals = std::to_string(ns / 10000 % 100);
+		return std::to_string(ns / 1000000) + "." + std::string(2 - decimals.size(), '0') + decimals;
+	};
+	auto line = [&](const char* name, const Histogram& h)
 	{
-		switch (e->key.keysym.sym)
-		{ // If pressed update key array in chip8 object
-		case SDLK_1: chip8->key[0] = 1; break;
-		case SDLK_2: chip8->key[1] = 1; break;
-		case SDLK_3: chip8->key[2] = 1; break;
-		case SDLK_4: chip8->key[3] = 1; break;
-		case SDLK_q: chip8->key[4] = 1; break;
-		case SDLK_w: chip8->key[5] = 1; break;
-		case SDLK_e: chip8->key[6] = 1; break;
-		case SDLK_r: chip8->key[7] = 1; break;
-		case SDLK_a: chip8->key[8] = 1; break;
-		case SDLK_s: chip8->key[9] = 1; break;
-		case SDLK_d: chip8->key[10] = 1; break;
-		case SDLK_f: chip8->key[11] = 1; break;
-		case SDLK_z: chip8->key[12] = 1; break;
-		case SDLK_x: chip8->key[13] = 1; break;
-		case SDLK_c: chip8->key[14] = 1; break;
-		case SDLK_v: chip8->key[15] = 1; break;
+		return std::string(name) + "p50 " + ms(h.percentile(0.5)) + "  p99 " + ms(h.percentile(0.99))
+			+ "  p999 " + ms(h.percentile(0.999)) + "  max " + ms(h.max());
+	};
+	return {
+		line("emulation ", times.emulation),
+		line("render    ", times.render),
+		line("present   ", times.present),
+		line("input     ", times.input),
+		"milliseconds, " + std::to_string(times.emulation.count()) + " frames"
+	};
+}
+
+void handleEvent(SDL_Event* e, Chip8* chip8, const char* keymap) {
+	// Check if a button is pressed or released
+	if ((e->type == SDL_KEYDOWN || e->type == SDL_KEYUP) && e->key.repeat == 0)
+	{
+		// Letter and digit keycodes are their lowercase character, find the CHIP-8 key mapped to it
+		for (int i = 0; i < KEY_LENGTH; i++)
+		{
+			if (e->key.keysym.sym == (SDL_Keycode)keymap[i])
+			{
+				chip8->key[i] = e->type == SDL_KEYDOWN; // Update key array in chip8 object
+				break;
+			}
 		}
 	}
-	// Check if a button is released
-	else if (e->type == SDL_KEYUP && e->key.repeat == 0)
+}
+
+bool debugHotkey(SDL_Keycode key, Debugger& debugger, const Chip8& chip8)
+{
+	switch (key)
 	{
-		switch (e->key.keysym.sym)
-		{// If released update key array in chip8 object
-		case SDLK_1: chip8->key[0] = 0; break;
-		case SDLK_2: chip8->key[1] = 0; break;
-		case SDLK_3: chip8->key[2] = 0; break;
-		case SDLK_4: chip8->key[3] = 0; break;
-		case SDLK_q: chip8->key[4] = 0; break;
-		case SDLK_w: chip8->key[5] = 0; break;
-		case SDLK_e: chip8->key[6] = 0; break;
-		case SDLK_r: chip8->key[7] = 0; break;
-		case SDLK_a: chip8->key[8] = 0; break;
-		case SDLK_s: chip8->key[9] = 0; break;
-		case SDLK_d: chip8->key[10] = 0; break;
-		case SDLK_f: chip8->key[11] = 0; break;
-		case SDLK_z: chip8->key[12] = 0; break;
-		case SDLK_x: chip8->key[13] = 0; break;
-		case SDLK_c: chip8->key[14] = 0; break;
-		case SDLK_v: chip8->key[15] = 0; break;
-		}
+	case SDLK_F5:
+		if (debugger.paused())
+			debugger.resume();
+		else
+			debugger.pause();
+		return true;
+
+	case SDLK_F9:
+		if (!debugger.clearBreakpoint(chip8.pc))
+			debugger.setBreakpoint(chip8.pc);
+		printf("%s %04X\n", debugger.hasBreakpoint(chip8.pc) ? "Breakpoint at" : "No breakpoint at", chip8.pc);
+		return true;
+
+	case SDLK_F10:
+		if (debugger.paused())
+			debugger.stepOver(chip8);
+		return true;
+
+	case SDLK_F11:
+		if (debugger.paused())
+			debugger.step();
+		return true;
 	}
+	return false;
 }
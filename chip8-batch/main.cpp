@@ -0,0 +1,203 @@
+// chip8-batch: runs many ROMs headless, from ROM packs or single files
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Chip8.h"
+#include "Chip8Pool.h"
+#include "Hash.h"
+#include "MappedFile.h"
+#include "Metrics.h"
+#include "RomPack.h"
+
+struct Job
+{
+	std::string name;
+	std::span<const uint8_t> image; // Points into a mapped pack or file
+	std::vector<uint64_t> frameHash; // Framebuffer of each instance after the last frame, to compare runs
+	bool loaded = false;
+	int exited = 0; // Instances that exited with 00FD
+	int halted = 0; // Instances halted on an unknown opcode
+};
+
+int main(int argc, char* args[])
+{
+	int frames = 600; // 10 seconds at 60 Hz
+	int instances = 1; // Instances of each ROM
+	int threads = (int)std::thread::hardware_concurrency();
+	const char* metricsPath = nullptr; // Prometheus text file rewritten while running (see Metrics.h)
+	int metricsInterval = METRICS_INTERVAL_MS / 1000;
+	std::optional<Platform> platform; // Instead of the one of the ROM database
+	std::vector<const char*> inputs;
+
+	for (int i = 1; i < argc; i++)
+	{
+		Platform named;
+		if (strcmp(args[i], "--frames") == 0 && i + 1 < argc)
+			frames = atoi(args[++i]);
+		else if (strcmp(args[i], "--instances") == 0 && i + 1 < argc)
+			instances = atoi(args[++i]);
+		else if (strcmp(args[i], "--threads") == 0 && i + 1 < argc)
+			threads = atoi(args[++i]);
+		else if (strcmp(args[i], "--metrics") == 0 && i + 1 < argc)
+			metricsPath = args[++i];
+		else if (strcmp(args[i], "--metrics-interval") == 0 && i + 1 < argc)
+			metricsInterval = atoi(args[++i]);
+		else if (strcmp(args[i], "--platform") == 0 && i + 1 < argc)
+		{
+			if (!parsePlatform(args[++i], named))
+			{
+				std::cout << "Unknown platform " << args[i] << ", expected vip, chip48, modern, schip or xochip" << std::endl;
+				return 1;
+			}
+			platform = named;
+		}
+		else
+			inputs.push_back(args[i]);
+	}
+	if (inputs.empty() || frames < 1 || instances < 1)
+	{
+		std::cout << "Usage: chip8-batch [--frames N] [--instances N] [--threads N] [--metrics file] [--metrics-interval seconds]"
+			" [--platform vip|chip48|modern|schip|xochip] <ROM pack, pack:ROM or ROM>..." << std::endl;
+		return 1;
+	}
+	if (threads < 1)
+		threads = 1;
+	if (metricsInterval < 1)
+		metricsInterval = 1;
+
+	// Keep every input mapped while running, the jobs use the images in place
+	std::vector<std::unique_ptr<RomPack>> packs;
+	std::vector<std::unique_ptr<MappedFile>> files;
+	std::vector<Job> jobs;
+	for (const char* input : inputs)
+	{
+		std::unique_ptr<RomPack> pack(new RomPack());
+		if (pack->open(input))
+		{
+			for (uint32_t i = 0; i < pack->size(); i++)
+			{
+				RomPack::Rom rom = pack->at(i);
+				jobs.push_back({ std::string(rom.name), rom.image, {} });
+			}
+			packs.push_back(std::move(pack));
+			continue;
+		}
+
+		std::unique_ptr<MappedFile> file(new MappedFile());
+		if (!file->open(input))
+		{
+			// A single ROM of a pack, pack:name or pack:hash
+			const char* colon = strrchr(input, ':');
+			RomPack::Rom rom;
+			if (colon && colon != input && pack->open(std::string(input, colon).c_str()) && pack->lookup(colon + 1, rom))
+			{
+				jobs.push_back({ std::string(rom.name), rom.image, {} });
+				packs.push_back(std::move(pack));
+			}
+			else
+				std::cout << "Can't open " << input << std::endl;
+			continue;
+		}
+		jobs.push_back({ input, file->bytes(), {} });
+		files.push_back(std::move(file));
+	}
+
+	// Each thread keeps a pool of instances and takes the next ROM until there are none left.
+	// The instances of a ROM are reset from one that has loaded it and run in lockstep, frame by frame.
+	std::atomic<size_t> next(0);
+	std::atomic<uint64_t> cycles(0);
+	MetricsExporter metrics(threads);
+	auto worker = [&](int id)
+	{
+		WorkerMetrics& m = metrics.worker(id);
+		Chip8 pristine;
+		Chip8Pool pool(instances);
+		uint64_t executed = 0;
+		for (size_t j = next++; j < jobs.size(); j = next++)
+		{
+			Job& job = jobs[j];
+			pristine.initialize();
+			if (!pristine.loadProgram(job.image, platform))
+				continue;
+			job.loaded = true;
+			pool.resetAll(pristine);
+			WorkerMetrics::add(m.snapshots, pool.size());
+			WorkerMetrics::add(m.snapshotBytes, pool.size() * sizeof(Chip8State));
+
+			int cyclesPerFrame = pristine.romInfo->cyclesPerFrame;
+			for (int f = 0; f < frames; f++)
+			{
+				uint64_t run = 0, idle = 0, unknown = 0, instancesRun = 0;
+				for (size_t n = 0; n < pool.size(); n++)
+					if (!pool[n].exited)
+					{
+						uint64_t idleBefore = pool[n].idleCycles;
+						uint32_t unknownBefore = pool[n].errors.unknownOpcodes;
+						pool[n].run(cyclesPerFrame);
+						run += cyclesPerFrame;
+						idle += pool[n].idleCycles - idleBefore;
+						unknown += pool[n].errors.unknownOpcodes - unknownBefore;
+						instancesRun++;
+					}
+				executed += run;
+				WorkerMetrics::add(m.instructions, run - idle);
+				WorkerMetrics::add(m.idleCycles, idle);
+				WorkerMetrics::add(m.frames, instancesRun);
+				if (unknown)
+					WorkerMetrics::add(m.unknownOpcodes, unknown);
+			}
+
+			for (size_t n = 0; n < pool.size(); n++)
+			{
+				job.exited += pool[n].exited && !pool[n].halted;
+				job.halted += pool[n].halted;
+				job.frameHash.push_back(xxhash64(pool[n].gfx, sizeof(pool[n].gfx)));
+			}
+			WorkerMetrics::add(m.roms, 1);
+		}
+		cycles += executed;
+	};
+
+	if (metricsPath)
+		metrics.start(metricsPath, metricsInterval * 1000);
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> pool;
+	for (int t = 0; t < threads; t++)
+		pool.emplace_back(worker, t);
+	for (std::thread& t : pool)
+		t.join();
+	metrics.stop();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	size_t runs = 0;
+	for (const Job& job : jobs)
+	{
+		if (!job.loaded)
+		{
+			std::cout << job.name << " (not loaded)" << std::endl;
+			continue;
+		}
+		for (uint64_t hash : job.frameHash)
+		{
+			std::cout << std::hex;
+			std::cout.width(16);
+			std::cout.fill('0');
+			std::cout << hash << std::dec << " " << job.name << std::endl;
+		}
+		if (job.exited)
+			std::cout << job.exited << " of " << instances << " instances of " << job.name << " exited" << std::endl;
+		if (job.halted)
+			std::cout << job.halted << " of " << instances << " instances of " << job.name << " halted on an unknown opcode" << std::endl;
+		runs += job.frameHash.size();
+	}
+	std::cout << runs << " runs, " << cycles << " cycles in " << seconds << " s ("
+		<< (uint64_t)(cycles / seconds) << " cycles/s, " << threads << " threads)" << std::endl;
+	return 0;
+}
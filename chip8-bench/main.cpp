@@ -0,0 +1,369 @@
+// chip8-bench: speed of the interpreter on a ROM corpus, with one instance and with many instances
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include "Chip8.h"
+#include "Chip8Pool.h"
+#include "Interpreter.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "RomPack.h"
+
+#define REPEATS 5 // Best of, to filter out the noise of other processes
+#define CORE "switch" // Interpreter measured, in the JSON results
+#define KEY_PERIOD 32 // Frames between two key presses of the input script
+#define KEY_FRAMES 8 // Frames a key is held
+
+/*
+ * Allocations of the process, counted by the replaced operator new
+*/
+static std::atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t align)
+{
+	// The block starts after the address to free, at the first aligned address
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	size_t alignment = (size_t)align < sizeof(void*) ? sizeof(void*) : (size_t)align;
+	unsigned char* block = (unsigned char*)malloc(size + alignment + sizeof(void*));
+	if (!block)
+		throw std::bad_alloc();
+	uintptr_t aligned = ((uintptr_t)block + sizeof(void*) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	((void**)aligned)[-1] = block;
+	return (void*)aligned;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { if (p) free(((void**)p)[-1]); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { if (p) free(((void**)p)[-1]); }
+
+struct Rom
+{
+	std::string name;
+	std::span<const uint8_t> image;
+};
+
+/*
+ * Results of a ROM, best of REPEATS
+*/
+struct Result
+{
+	int frames = 0; // Run before the program exited or halted
+	uint64_t instructions = 0;
+	uint64_t idleCycles = 0; // Skipped while the program waited in place, not counted as instructions
+	double mips = 0; // One instance
+	double fps = 0; // One instance, frames per second
+	uint64_t draws = 0; // DXYN executed
+	double nsPerDraw = 0;
+	uint64_t allocations = 0; // While running, the setup excluded
+	double multiMips = 0; // Spread over the instances of the pool
+	bool halted = false;
+};
+
+/*
+ * Scripted input: each key in turn is held a few frames, so the games leave their title screen and
+ * every run of a ROM is the same
+*/
+static void pressKeys(Chip8& c, int frame)
+{
+	memset(c.key, 0, sizeof(c.key));
+	if (frame % KEY_PERIOD < KEY_FRAMES)
+		c.key[(frame / KEY_PERIOD) & 0xF] = 1;
+}
+
+/*
+ * Time of the DXYN instructions, the hooks of a second interpreter specialization (see Interpreter.h)
+*/
+struct DrawTimer : NoHooks
+{
+	using clock = std::chrono::steady_clock;
+
+	void instruction(const Chip8& c, unsigned short opcode)
+	{
+		if ((opcode & 0xF000) == 0xD000)
+			start = clock::now();
+	}
+	void executed(const Chip8& c, unsigned short pc, unsigned short opcode)
+	{
+		if ((opcode & 0xF000) == 0xD000)
+		{
+			elapsed += clock::now() - start;
+			draws++;
+		}
+	}
+
+	clock::time_point start;
+	clock::duration elapsed{};
+	uint64_t draws = 0;
+};
+
+/*
+ * Time of a clock::now() pair, taken out of the DXYN times
+*/
+static double clockOverhead()
+{
+	double best = 1e9;
+	for (int i = 0; i < 1000; i++)
+	{
+		auto a = DrawTimer::clock::now();
+		auto b = DrawTimer::clock::now();
+		best = std::min(best, std::chrono::duration<double, std::nano>(b - a).count());
+	}
+	return best;
+}
+
+/*
+ * Run frames frames of the ROM on one instance with the input script: instructions and frames per second,
+ * allocations, then the time of DXYN with the timing interpreter
+*/
+static void single(const Rom& rom, int frames, double overhead, Result& result)
+{
+	for (int r = 0; r < REPEATS; r++)
+	{
+		Chip8 chip8;
+		chip8.initialize();
+		chip8.loadProgram(rom.image);
+		int cyclesPerFrame = chip8.romInfo->cyclesPerFrame;
+
+		int f = 0;
+		uint64_t allocated = allocations.load(std::memory_order_relaxed);
+		auto start = std::chrono::steady_clock::now();
+		for (; f < frames && !chip8.exited; f++)
+		{
+			pressKeys(chip8, f);
+			chip8.run(cyclesPerFrame);
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		uint64_t executed = (uint64_t)f * cyclesPerFrame - chip8.idleCycles;
+
+		result.frames = f;
+		result.instructions = executed;
+		result.idleCycles = chip8.idleCycles;
+		result.allocations = allocations.load(std::memory_order_relaxed) - allocated;
+		result.halted = chip8.halted;
+		if (seconds > 0 && executed / seconds / 1e6 > result.mips)
+		{
+			result.mips = executed / seconds / 1e6;
+			result.fps = f / seconds;
+		}
+	}
+
+	for (int r = 0; r < REPEATS; r++)
+	{
+		Chip8 chip8;
+		chip8.initialize();
+		chip8.loadProgram(rom.image);
+		int cyclesPerFrame = chip8.romInfo->cyclesPerFrame;
+
+		DrawTimer timer;
+		for (int f = 0; f < frames && !chip8.exited; f++)
+		{
+			pressKeys(chip8, f);
+			withPlatform(chip8.platform, [&](auto p)
+				{
+					Interpreter<decltype(p), DrawTimer>::run(chip8, cyclesPerFrame, timer);
+				});
+		}
+		result.draws = timer.draws;
+		if (timer.draws)
+		{
+			double ns = std::chrono::duration<double, std::nano>(timer.elapsed).count() / timer.draws - overhead;
+			if (r == 0 || ns < result.nsPerDraw)
+				result.nsPerDraw = ns > 0 ? ns : 0;
+		}
+	}
+}
+
+/*
+ * Millions of instructions per second running cycles instructions spread over the instances of a pool,
+ * one frame of each instance in turn like a batch run
+*/
+static double multi(const Rom& rom, uint64_t cycles, Chip8Pool& pool)
+{
+	Chip8 pristine;
+	pristine.initialize();
+	pristine.loadProgram(rom.image);
+	int cyclesPerFrame = pristine.romInfo->cyclesPerFrame;
+
+	double best = 0;
+	for (int r = 0; r < REPEATS; r++)
+	{
+		pool.resetAll(pristine);
+
+		uint64_t executed = 0, before = 1;
+		auto start = std::chrono::steady_clock::now();
+		while (executed < cycles && executed != before) // Until every instance has exited
+		{
+			before = executed;
+			for (size_t n = 0; n < pool.size(); n++)
+				if (!pool[n].exited)
+				{
+					pool[n].run(cyclesPerFrame);
+					executed += cyclesPerFrame;
+				}
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		for (size_t n = 0; n < pool.size(); n++)
+			executed -= pool[n].idleCycles;
+		if (seconds > 0 && executed / seconds / 1e6 > best)
+			best = executed / seconds / 1e6;
+	}
+	return best;
+}
+
+/*
+ * ROM name as a JSON string
+*/
+static std::string quote(const std::string& text)
+{
+	std::string quoted = "\"";
+	for (char ch : text)
+	{
+		if (ch == '"' || ch == '\\')
+			quoted += '\\';
+		if ((unsigned char)ch >= 0x20)
+			quoted += ch;
+	}
+	return quoted + "\"";
+}
+
+/*
+ * Results as JSON, to compare runs across commits
+*/
+static bool writeJson(const char* path, int frames, uint64_t cycles, int instances, const std::vector<Rom>& roms,
+	const std::vector<Result>& results)
+{
+	std::ofstream out(path);
+	out << "{\n  \"core\": \"" CORE "\",\n  \"frames\": " << frames << ",\n  \"cycles\": " << cycles
+		<< ",\n  \"instances\": " << instances << ",\n  \"roms\": [";
+	for (size_t i = 0; i < roms.size(); i++)
+	{
+		const Result& r = results[i];
+		out << (i ? "," : "") << "\n    { \"name\": " << quote(roms[i].name) << ", \"frames\": " << r.frames
+			<< ", \"instructions\": " << r.instructions << ", \"idle_cycles\": " << r.idleCycles << ", \"instructions_per_second\": " << (uint64_t)(r.mips * 1e6)
+			<< ", \"frames_per_second\": " << (uint64_t)r.fps << ", \"dxyn\": " << r.draws
+			<< ", \"ns_per_dxyn\": " << r.nsPerDraw << ", \"allocations\": " << r.allocations
+			<< ", \"multi_instructions_per_second\": " << (uint64_t)(r.multiMips * 1e6)
+			<< ", \"halted\": " << (r.halted ? "true" : "false") << " }";
+	}
+	out << "\n  ]\n}\n";
+	out.close();
+	return !out.fail();
+}
+
+int main(int argc, char* args[])
+{
+	int frames = 60000; // About 17 minutes of play at 60 Hz
+	uint64_t cycles = 20000000;
+	int instances = 4096;
+	const char* jsonPath = nullptr;
+	std::vector<const char*> inputs;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(args[i], "--frames") == 0 && i + 1 < argc)
+			frames = atoi(args[++i]);
+		else if (strcmp(args[i], "--cycles") == 0 && i + 1 < argc)
+			cycles = strtoull(args[++i], NULL, 10);
+		else if (strcmp(args[i], "--instances") == 0 && i + 1 < argc)
+			instances = atoi(args[++i]);
+		else if (strcmp(args[i], "--json") == 0 && i + 1 < argc)
+			jsonPath = args[++i];
+		else
+			inputs.push_back(args[i]);
+	}
+	if (inputs.empty() || instances < 1 || frames < 1)
+	{
+		std::cout << "Usage: chip8-bench [--frames N] [--cycles N] [--instances N] [--json file] <ROM pack, ROM or directory>..." << std::endl;
+		return 1;
+	}
+
+	std::vector<std::unique_ptr<RomPack>> packs;
+	std::vector<std::unique_ptr<MappedFile>> files;
+	std::vector<Rom> roms;
+	std::vector<std::string> paths;
+	for (const char* input : inputs)
+	{
+		// Every file of a directory, in name order so the results line up across runs
+		std::error_code error;
+		if (!std::filesystem::is_directory(input, error))
+		{
+			paths.push_back(input);
+			continue;
+		}
+		size_t first = paths.size();
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(input, error))
+			if (entry.is_regular_file(error))
+				paths.push_back(entry.path().string());
+		std::sort(paths.begin() + first, paths.end());
+	}
+
+	for (const std::string& path : paths)
+	{
+		const char* input = path.c_str();
+		std::unique_ptr<RomPack> pack(new RomPack());
+		if (pack->open(input))
+		{
+			for (uint32_t i = 0; i < pack->size(); i++)
+				roms.push_back({ std::string(pack->at(i).name), pack->at(i).image });
+			packs.push_back(std::move(pack));
+			continue;
+		}
+
+		std::unique_ptr<MappedFile> file(new MappedFile());
+		if (!file->open(input))
+		{
+			std::cout << "Can't open " << input << std::endl;
+			continue;
+		}
+		roms.push_back({ std::filesystem::path(path).filename().string(), file->bytes() });
+		files.push_back(std::move(file));
+	}
+
+	// Don't log the unknown opcodes of the ROMs, keep the table readable
+	LogSink::global().setEnabled(false);
+	std::cout.setf(std::ios::fixed);
+	std::cout.precision(1);
+
+	Chip8Pool pool(instances);
+	double overhead = clockOverhead();
+	double totalSingle = 0, totalMulti = 0;
+	std::vector<Result> results(roms.size());
+	std::cout << "ROM\tMIPS\tMIPS x" << instances << "\tFrames/s\tns/DXYN\tAllocations" << std::endl;
+	for (size_t i = 0; i < roms.size(); i++)
+	{
+		Result& r = results[i];
+		single(roms[i], frames, overhead, r);
+		r.multiMips = multi(roms[i], cycles, pool);
+		std::cout << roms[i].name << "\t" << r.mips << "\t" << r.multiMips << "\t" << r.fps << "\t" << r.nsPerDraw
+			<< "\t" << r.allocations << (r.halted ? "\thalted" : "") << std::endl;
+		totalSingle += r.mips;
+		totalMulti += r.multiMips;
+	}
+	std::cout << "Mean MIPS: " << totalSingle / roms.size() << " with 1 instance, "
+		<< totalMulti / roms.size() << " with " << instances << " instances (" << sizeof(Chip8) << " bytes each)" << std::endl;
+
+	if (jsonPath && !writeJson(jsonPath, frames, cycles, instances, roms, results))
+	{
+		std::cout << "Can't write " << jsonPath << std::endl;
+		return 1;
+	}
+	return 0;
+}
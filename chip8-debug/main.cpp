@@ -0,0 +1,69 @@
+// chip8-debug: runs a ROM headless under the debugger, driven by commands read from the standard input
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include "Chip8.h"
+#include "Debugger.h"
+
+int main(int argc, char* args[])
+{
+	int frames = 3600; // Longest continue, a minute at 60 Hz
+	const char* rom = nullptr;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(args[i], "--frames") == 0 && i + 1 < argc)
+			frames = atoi(args[++i]);
+		else
+			rom = args[i];
+	}
+	if (!rom || frames < 1)
+	{
+		std::cout << "Usage: chip8-debug [--frames N] <ROM>" << std::endl
+			<< "Commands are read from the standard input, help lists them." << std::endl;
+		return 1;
+	}
+
+	Chip8 chip8;
+	chip8.initialize();
+	if (!chip8.loadProgram(rom))
+	{
+		std::cout << std::endl;
+		return 1;
+	}
+	const RomInfo& info = *chip8.romInfo;
+	std::cout << (info.name ? info.name : rom) << ": " << withPlatform(info.platform, [](auto p) { return p.name; }) << ", "
+		<< info.cyclesPerFrame << " cycles/frame" << std::endl;
+
+	// Start paused on the first instruction
+	Debugger debugger;
+	debugger.pause();
+	debugger.printState(chip8, std::cout);
+
+	std::string line;
+	int frameCycles = 0; // Cycles of the current frame run so far, a frame goes on where a stop left it
+	while (std::cout << "> " << std::flush && std::getline(std::cin, line))
+	{
+		if (!debugger.command(chip8, line, std::cout))
+			break;
+		if (debugger.paused())
+			continue;
+
+		for (int f = 0; f < frames && !debugger.paused(); f++)
+		{
+			frameCycles += debugger.run(chip8, info.cyclesPerFrame - frameCycles);
+			if (frameCycles == info.cyclesPerFrame)
+				frameCycles = 0;
+		}
+		if (!debugger.paused())
+		{
+			debugger.pause();
+			std::cout << "Still running after " << frames << " frames" << std::endl;
+		}
+		else if (!debugger.stopMessage().empty())
+			std::cout << debugger.stopMessage() << std::endl;
+		debugger.printState(chip8, std::cout);
+	}
+	return 0;
+}
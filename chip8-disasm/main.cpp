@@ -0,0 +1,181 @@
+// chip8-disasm: disassembles a ROM by following its control flow, telling the code from the sprites and the data
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <string>
+#include "ControlFlow.h"
+#include "Disassembler.h"
+#include "Hash.h"
+#include "MappedFile.h"
+#include "RomDatabase.h"
+#include "RomImage.h"
+
+#define DATA_PER_LINE 8 // Bytes of data or unreached bytes per line
+
+static const char* const endNames[] =
+{
+	"", "", "", "", "", "indirect jump, only the target for a register of 0 is followed", "", "",
+	"unknown opcode, the program stops here", "runs past the end of the ROM"
+};
+
+static std::string hex(unsigned int value, int digits)
+{
+	std::string text(digits, '0');
+	for (int i = digits - 1; i >= 0; i--, value >>= 4)
+		text[i] = "0123456789ABCDEF"[value & 0xF];
+	return text;
+}
+
+static std::string label(const ControlFlowGraph& cfg, unsigned int addr)
+{
+	bool subroutine = std::binary_search(cfg.subroutines.begin(), cfg.subroutines.end(), addr);
+	return (subroutine ? "sub_" : "loc_") + hex(addr, 4);
+}
+
+static unsigned short opcodeAt(std::span<const uint8_t> rom, unsigned int addr)
+{
+	unsigned int offset = addr - APP_DATA;
+	return (unsigned short)(rom[offset] << 8 | (offset + 1 < rom.size() ? rom[offset + 1] : 0));
+}
+
+/*
+ * Listing of the ROM in address order: the blocks under their labels, the sprites drawn as pixels,
+ * the data and the unreached bytes in hexadecimal
+*/
+static void writeListing(const ControlFlowGraph& cfg, std::span<const uint8_t> rom, std::ostream& out)
+{
+	unsigned int end = APP_DATA + (unsigned int)rom.size();
+	const BasicBlock* block = nullptr; // Containing the last instruction
+	for (unsigned int addr = APP_DATA; addr < end;)
+	{
+		ByteKind kind = cfg.bytes[addr];
+		if (kind == ByteKind::Code)
+		{
+			if (const BasicBlock* start = cfg.blockAt(addr))
+			{
+				block = start;
+				out << "\n" << label(cfg, addr) << ":\n";
+			}
+			unsigned short opcode = opcodeAt(rom, addr);
+			out << "  " << hex(addr, 4) << ": " << hex(opcode, 4) << "  " << disassemble(opcode, cfg.platform);
+			unsigned int length = cfg.platform == Platform::XoChip && opcode == 0xF000 && addr + 3 < end ? 4 : 2;
+			if (length == 4)
+				out << " " << hex(opcodeAt(rom, addr + 2), 4);
+			addr += length;
+			if (block && block->end == addr && *endNames[(int)block->kind])
+				out << "  ; " << endNames[(int)block->kind];
+			out << "\n";
+		}
+		else if (kind == ByteKind::Sprite)
+		{
+			unsigned int bits = rom[addr - APP_DATA];
+			std::string pixels;
+			for (int b = 7; b >= 0; b--)
+				pixels += (bits >> b) & 1 ? '#' : '.';
+			out << "  " << hex(addr, 4) << ": " << hex(bits, 2) << "    " << pixels << "\n";
+			addr++;
+		}
+		else
+		{
+			// A line of consecutive bytes of the same kind
+			out << "  " << hex(addr, 4) << ":";
+			unsigned int first = addr;
+			do
+				out << " " << hex(rom[addr - APP_DATA], 2);
+			while (++addr < end && addr - first < DATA_PER_LINE && cfg.bytes[addr] == kind);
+			out << (kind == ByteKind::Data ? "  ; data" : kind == ByteKind::Unknown ? "  ; unreached" : "") << "\n";
+		}
+	}
+}
+
+/*
+ * Graphviz graph of the blocks: jumps, skips and fall throughs as solid edges, calls dashed
+*/
+static void writeDot(const ControlFlowGraph& cfg, std::span<const uint8_t> rom, std::ostream& out)
+{
+	out << "digraph cfg {\n\tnode [shape=box, fontname=monospace];\n";
+	unsigned int end = APP_DATA + (unsigned int)rom.size();
+	for (const BasicBlock& block : cfg.blocks)
+	{
+		out << "\tb" << hex(block.start, 4) << " [label=\"" << label(cfg, block.start) << "\\l";
+		for (unsigned int addr = block.start; addr < block.end && addr + 1 < end; addr += 2)
+			out << hex(addr, 4) << "  " << disassemble(opcodeAt(rom, addr), cfg.platform) << "\\l";
+		out << "\"];\n";
+		for (uint16_t target : block.successors)
+			out << "\tb" << hex(block.start, 4) << " -> b" << hex(target, 4) << ";\n";
+		if (block.kind == BlockEnd::Call)
+			out << "\tb" << hex(block.start, 4) << " -> b" << hex(block.callee, 4) << " [style=dashed];\n";
+	}
+	out << "}\n";
+}
+
+int main(int argc, char* args[])
+{
+	const char* path = nullptr;
+	std::optional<Platform> platform; // Instead of the one of the ROM database
+	bool dot = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		Platform named;
+		if (strcmp(args[i], "--platform") == 0 && i + 1 < argc)
+		{
+			if (!parsePlatform(args[++i], named))
+			{
+				std::cout << "Unknown platform " << args[i] << ", expected vip, chip48, modern, schip or xochip" << std::endl;
+				return 1;
+			}
+			platform = named;
+		}
+		else if (strcmp(args[i], "--dot") == 0)
+			dot = true;
+		else
+			path = args[i];
+	}
+	if (!path)
+	{
+		std::cout << "Usage: chip8-disasm [--platform vip|chip48|modern|schip|xochip] [--dot] <ROM>" << std::endl;
+		return 1;
+	}
+
+	MappedFile file;
+	if (!file.open(path))
+	{
+		std::cout << "Can't open " << path << std::endl;
+		return 1;
+	}
+	std::span<const uint8_t> rom = file.bytes();
+	if (rom.size() > CFG_ADDRESSES - APP_DATA)
+	{
+		std::cout << path << " is too big for the Chip8 memory" << std::endl;
+		return 1;
+	}
+
+	const RomInfo& info = findRom(xxhash64(rom.data(), rom.size()));
+	Platform selected = platform ? *platform : info.platform;
+	ControlFlowGraph cfg = buildControlFlow(rom, selected);
+	if (dot)
+	{
+		writeDot(cfg, rom, std::cout);
+		return 0;
+	}
+
+	int counts[5] = {};
+	for (unsigned int addr = APP_DATA; addr < APP_DATA + rom.size(); addr++)
+		counts[(int)cfg.bytes[addr]]++;
+	std::cout << "; " << (info.name ? info.name : path) << ", " << withPlatform(selected, [](auto p) { return p.name; }) << ": "
+		<< cfg.blocks.size() << " blocks, " << cfg.subroutines.size() << " subroutines" << std::endl
+		<< "; " << counts[(int)ByteKind::Code] + counts[(int)ByteKind::Operand] << " bytes of code, "
+		<< counts[(int)ByteKind::Sprite] << " of sprites, " << counts[(int)ByteKind::Data] << " of data, "
+		<< counts[(int)ByteKind::Unknown] << " unreached" << std::endl;
+	if (!cfg.indirectJumps.empty())
+		std::cout << "; " << cfg.indirectJumps.size() << " indirect jumps, the code they reach may be listed as unreached" << std::endl;
+	if (!cfg.invalid.empty())
+		std::cout << "; " << cfg.invalid.size() << " reachable unknown opcodes" << std::endl;
+	if (cfg.overlaps)
+		std::cout << "; " << cfg.overlaps << " bytes used as two kinds, e.g. code and sprite" << std::endl;
+	writeListing(cfg, rom, std::cout);
+	return 0;
+}
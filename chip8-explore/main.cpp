@@ -0,0 +1,259 @@
+// chip8-explore: explores the inputs of a ROM breadth first, frame by frame, to find the screens and the code it can reach
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Chip8.h"
+#include "Chip8Pool.h"
+
+#define NO_KEY 16 // Branch with no key pressed
+#define BRANCHES 17 // One per key and one without keys
+#define MAX_PROBES 64
+
+/*
+ * Set of 64 bit hashes shared by all the threads, open addressing with linear probing.
+ * Inserting is a single compare and swap, there are no locks and no removals.
+*/
+class HashSet
+{
+public:
+	explicit HashSet(int bits) : mask((1ull << bits) - 1), slots(new std::atomic<uint64_t>[1ull << bits])
+	{
+		for (uint64_t i = 0; i <= mask; i++)
+			slots[i].store(0, std::memory_order_relaxed);
+	}
+
+	/*
+	 * Returns true if the hash wasn't in the set yet. A full neighbourhood counts as already seen.
+	*/
+	bool insert(uint64_t hash)
+	{
+		if (hash == 0) // 0 marks the empty slots
+			hash = 1;
+		for (uint64_t i = 0; i < MAX_PROBES; i++)
+		{
+			std::atomic<uint64_t>& slot = slots[(hash + i) & mask];
+			uint64_t current = slot.load(std::memory_order_relaxed);
+			if (current == hash)
+				return false;
+			if (current == 0)
+			{
+				if (slot.compare_exchange_strong(current, hash, std::memory_order_relaxed))
+				{
+					size++;
+					return true;
+				}
+				if (current == hash) // Another thread inserted the same hash
+					return false;
+			}
+		}
+		full++;
+		return false;
+	}
+
+	std::atomic<uint64_t> size{ 0 };
+	std::atomic<uint64_t> full{ 0 }; // Insertions given up, the set is too small
+
+private:
+	uint64_t mask;
+	std::unique_ptr<std::atomic<uint64_t>[]> slots;
+};
+
+/*
+ * A state of the frontier: the state it was forked from and the key pressed during the frame that led to it
+*/
+struct Node
+{
+	uint32_t parent;
+	uint8_t key;
+};
+
+/*
+ * A screen seen for the first time, reached by pressing key from the state parent of the level
+*/
+struct Screen
+{
+	uint64_t hash;
+	int level;
+	uint32_t parent;
+	uint8_t key;
+};
+
+/*
+ * Inputs that lead to a node, one character per frame: the key in hex, or - without keys
+*/
+static std::string inputs(const std::vector<std::vector<Node>>& levels, int level, uint32_t index)
+{
+	std::string sequence;
+	for (; level > 0; level--)
+	{
+		const Node& node = levels[level][index];
+		sequence += node.key == NO_KEY ? '-' : "0123456789ABCDEF"[node.key];
+		index = node.parent;
+	}
+	std::reverse(sequence.begin(), sequence.end());
+	return sequence;
+}
+
+int main(int argc, char* args[])
+{
+	int depth = 60; // Frames
+	int frontier = 4096; // States kept per frame
+	int threads = (int)std::thread::hardware_concurrency();
+	int visitedBits = 22;
+	const char* rom = nullptr;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(args[i], "--depth") == 0 && i + 1 < argc)
+			depth = atoi(args[++i]);
+		else if (strcmp(args[i], "--frontier") == 0 && i + 1 < argc)
+			frontier = atoi(args[++i]);
+		else if (strcmp(args[i], "--threads") == 0 && i + 1 < argc)
+			threads = atoi(args[++i]);
+		else if (strcmp(args[i], "--visited-bits") == 0 && i + 1 < argc)
+			visitedBits = atoi(args[++i]);
+		else
+			rom = args[i];
+	}
+	if (!rom || depth < 1 || frontier < 1 || visitedBits < 10 || visitedBits > 34)
+	{
+		std::cout << "Usage: chip8-explore [--depth frames] [--frontier states] [--threads N] [--visited-bits N] <ROM>" << std::endl;
+		return 1;
+	}
+	if (threads < 1)
+		threads = 1;
+
+	Chip8 start;
+	start.initialize();
+	if (!start.loadProgram(rom))
+		return 1;
+	int cyclesPerFrame = start.romInfo->cyclesPerFrame;
+	unsigned int memSize = start.memSize;
+
+	// Two generations of states, the current frontier and the next one
+	std::unique_ptr<Chip8Pool> current(new Chip8Pool(frontier));
+	std::unique_ptr<Chip8Pool> next(new Chip8Pool(frontier));
+	start.cloneInto((*current)[0]);
+	size_t currentSize = 1;
+
+	HashSet visited(visitedBits);
+	HashSet screens(visitedBits);
+	visited.insert(start.fingerprint());
+
+	std::vector<std::vector<Node>> levels(1, std::vector<Node>(1, Node{ 0, NO_KEY }));
+	std::vector<Screen> found;
+	std::mutex foundLock;
+	std::vector<std::vector<uint64_t>> coverage(threads, std::vector<uint64_t>(memSize));
+	uint64_t dropped = 0;
+
+	for (int level = 0; level < depth && currentSize > 0; level++)
+	{
+		levels.emplace_back(frontier);
+		std::vector<Node>& nodes = levels.back();
+		std::atomic<size_t> nextSize(0);
+		std::atomic<size_t> work(0);
+		std::atomic<uint64_t> lost(0);
+
+		// Each thread forks the states it takes into one clone per branch and keeps the new states
+		auto worker = [&](int t)
+		{
+			Chip8Pool branches(BRANCHES);
+			std::vector<uint64_t>& covered = coverage[t];
+			for (size_t s = work++; s < currentSize; s = work++)
+			{
+				(*current)[s].fork(branches.data(), BRANCHES);
+				for (int b = 0; b < BRANCHES; b++)
+				{
+					// No key first, so states that don't depend on the keys are reached without them
+					int key = (b + NO_KEY) % BRANCHES;
+					Chip8& c = branches[b];
+					memset(c.key, 0, sizeof(c.key));
+					if (key != NO_KEY)
+						c.key[key] = 1;
+
+					// Step cycle by cycle to record the address of every instruction
+					for (int i = 0; i < cyclesPerFrame && !c.exited; i++)
+					{
+						covered[c.pc & (memSize - 1)]++;
+						c.emulateCycle();
+					}
+
+					if (!visited.insert(c.fingerprint()))
+						continue;
+
+					uint64_t screen = c.gfxHash[0] ^ mix64(c.gfxHash[1] + 1);
+					if (screens.insert(screen))
+					{
+						std::lock_guard<std::mutex> guard(foundLock);
+						found.push_back({ screen, level, (uint32_t)s, (uint8_t)key });
+					}
+
+					size_t index = nextSize++;
+					if (index >= (size_t)frontier)
+					{
+						lost++;
+						continue;
+					}
+					c.cloneInto((*next)[index]);
+					nodes[index] = { (uint32_t)s, (uint8_t)key };
+				}
+			}
+		};
+
+		std::vector<std::thread> pool;
+		for (int t = 0; t < threads; t++)
+			pool.emplace_back(worker, t);
+		for (std::thread& t : pool)
+			t.join();
+
+		currentSize = std::min(nextSize.load(), (size_t)frontier);
+		nodes.resize(currentSize);
+		dropped += lost;
+		std::swap(current, next);
+		std::cout << "Frame " << level + 1 << ": " << currentSize << " new states, "
+			<< visited.size << " visited, " << screens.size << " screens" << std::endl;
+	}
+
+	// Merge the coverage of the threads
+	std::vector<uint64_t> total(memSize);
+	for (const std::vector<uint64_t>& covered : coverage)
+		for (unsigned int a = 0; a < memSize; a++)
+			total[a] += covered[a];
+
+	std::cout << std::endl << "Coverage (address: instructions executed)" << std::endl;
+	unsigned int addresses = 0;
+	for (unsigned int a = 0; a < memSize; a++)
+		if (total[a])
+		{
+			std::cout << std::hex;
+			std::cout.width(4);
+			std::cout.fill('0');
+			std::cout << a << std::dec << ": " << total[a] << std::endl;
+			addresses++;
+		}
+
+	std::cout << std::endl << "Screens (hash: inputs from the start, one frame per character, - for no key)" << std::endl;
+	for (const Screen& screen : found)
+	{
+		std::cout << std::hex;
+		std::cout.width(16);
+		std::cout.fill('0');
+		std::cout << screen.hash << std::dec << ": " << inputs(levels, screen.level, screen.parent)
+			<< (screen.key == NO_KEY ? '-' : "0123456789ABCDEF"[screen.key]) << std::endl;
+	}
+
+	std::cout << std::endl << visited.size << " unique states, " << found.size() << " unique screens, "
+		<< addresses << " instruction addresses covered" << std::endl;
+	if (dropped)
+		std::cout << dropped << " new states didn't fit in the frontier (--frontier)" << std::endl;
+	if (visited.full || screens.full)
+		std::cout << "The visited set is full, states may be counted as seen (--visited-bits)" << std::endl;
+	return 0;
+}
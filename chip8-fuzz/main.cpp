@@ -0,0 +1,119 @@
+// chip8-fuzz: libFuzzer target running random programs and key streams through the interpreter
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "Chip8.h"
+#include "Log.h"
+
+#define FUZZ_FRAMES 64 // Cycle budget of an input, in frames
+#define FUZZ_KEY_FRAMES 16 // Key states of an input, repeated over the frames
+#define FUZZ_HEADER (2 + 2 * FUZZ_KEY_FRAMES) // Platform, policy and key states before the program
+
+/*
+ * Input of the fuzzer:
+ *  byte 0       platform (Platform, modulo the number of platforms)
+ *  byte 1       unknown opcode policy (UnknownOpcodePolicy, modulo 3)
+ *  bytes 2-33   16 key states, a 16 bit mask of the pressed keys per frame
+ *  bytes 34-    the program, loaded at 0x200
+ *
+ * Each input is run twice, with Chip8::run() a frame at a time and with emulateCycle() an instruction
+ * at a time, and the two machines must stay identical. Halfway through, the first one continues in a
+ * clone of itself, so the pages shared by clones are exercised too.
+ * Any invariant of the state that doesn't hold aborts, so the fuzzer keeps the input.
+*/
+
+static void check(bool ok, const char* what)
+{
+	if (ok)
+		return;
+	std::cout << "chip8-fuzz: " << what << std::endl;
+	abort();
+}
+
+static void checkState(const Chip8& c)
+{
+	check(c.sp < STACK_LENGTH, "stack pointer out of the stack");
+	check(c.pc < c.memSize, "pc out of the memory");
+	check(c.planes <= 3, "planes out of range");
+	check((c.width == LORES_WIDTH && c.height == LORES_HEIGHT) || (c.width == HIRES_WIDTH && c.height == HIRES_HEIGHT),
+		"unknown resolution");
+	check(!c.halted || c.exited, "halted without stopping");
+	for (unsigned int p = c.memSize >> MEM_PAGE_SHIFT; p < MAX_PAGES; p++)
+		check(!(c.privatePages[p >> 6] & (1ull << (p & 63))), "private page past the end of the memory");
+}
+
+static void pressKeys(Chip8& c, const uint8_t* keys, int frame)
+{
+	int i = frame % FUZZ_KEY_FRAMES;
+	unsigned int mask = keys[2 * i] | keys[2 * i + 1] << 8;
+	for (int k = 0; k < KEY_LENGTH; k++)
+		c.key[k] = (mask >> k) & 1;
+}
+
+// Go on with the next instruction, the trap of UnknownOpcodePolicy::Trap
+static void skipOpcode(Chip8& c)
+{
+	c.pc += 2;
+}
+
+/*
+ * Power on a machine and load the program the way the frontend does, through the shared ROM images.
+ * Returns false if it doesn't fit in the memory.
+*/
+static bool load(Chip8& c, Platform platform, UnknownOpcodePolicy policy, const uint8_t* program, size_t size)
+{
+	c.unknownOpcodePolicy = policy;
+	c.unknownOpcodeTrap = skipOpcode;
+	c.initialize(platform);
+	if (size > c.memSize - APP_DATA)
+		return false; // Checked here, loadProgram() would print it for every input
+	return c.loadProgram(std::span<const uint8_t>(program, size), platform);
+}
+
+extern "C" int LLVMFuzzerInitialize(int* argc, char*** argv)
+{
+	// Programs made of random bytes meet unknown opcodes all the time
+	LogSink::global().setEnabled(false);
+	return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	if (size < FUZZ_HEADER)
+		return 0;
+	Platform platform = (Platform)(data[0] % ((int)Platform::XoChip + 1));
+	UnknownOpcodePolicy policy = (UnknownOpcodePolicy)(data[1] % 3);
+	const uint8_t* keys = data + 2;
+	const uint8_t* program = data + FUZZ_HEADER;
+	size_t programSize = size - FUZZ_HEADER;
+
+	Chip8 frames, cycles, clone;
+	if (!load(frames, platform, policy, program, programSize))
+		return 0;
+	load(cycles, platform, policy, program, programSize);
+
+	Chip8* c = &frames;
+	int cyclesPerFrame = frames.romInfo->cyclesPerFrame;
+	for (int f = 0; f < FUZZ_FRAMES; f++)
+	{
+		if (f == FUZZ_FRAMES / 2)
+		{
+			frames.cloneInto(clone);
+			c = &clone;
+		}
+
+		pressKeys(*c, keys, f);
+		c->run(cyclesPerFrame);
+		pressKeys(cycles, keys, f);
+		for (int i = 0; i < cyclesPerFrame; i++)
+			cycles.emulateCycle();
+
+		checkState(*c);
+		check(c->fingerprint() == cycles.fingerprint(), "run() and emulateCycle() diverged");
+		check(c->playSound == cycles.playSound, "run() and emulateCycle() diverged outside the fingerprint");
+		if (c->exited)
+			break;
+	}
+	return 0;
+}
@@ -0,0 +1,290 @@
+// chip8-golden: runs ROMs headless and compares their screens at checkpoints with stored golden hashes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Chip8.h"
+#include "Hash.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "RomPack.h"
+
+#define KEY_PERIOD 32 // Frames between two key presses of the input script
+#define KEY_FRAMES 8 // Frames a key is held
+
+struct Rom
+{
+	std::string name;
+	std::span<const uint8_t> image;
+	std::vector<uint64_t> hashes; // Screen at each checkpoint
+	bool loaded = false;
+};
+
+/*
+ * Scripted input: each key in turn is held a few frames, so the games leave their title screen and
+ * every run of a ROM is the same
+*/
+static void pressKeys(Chip8& c, int frame)
+{
+	memset(c.key, 0, sizeof(c.key));
+	if (frame % KEY_PERIOD < KEY_FRAMES)
+		c.key[(frame / KEY_PERIOD) & 0xF] = 1;
+}
+
+/*
+ * Hash of what is on the screen: the resolution and the color of each pixel, and whether the program stopped.
+ * It doesn't depend on how the framebuffer is stored, so the golden hashes survive changes of the core.
+ * A program that halted on an unknown opcode or exited hashes differently from one showing the same screen
+ * while running, so a run that stopped can't be recorded as golden unnoticed.
+*/
+static uint64_t screenHash(const Chip8& c)
+{
+	std::vector<uint8_t> pixels;
+	pixels.reserve(2 + (size_t)c.width * c.height);
+	pixels.push_back((uint8_t)(c.width >> 1));
+	pixels.push_back((uint8_t)c.height);
+	for (int y = 0; y < c.height; y++)
+		for (int x = 0; x < c.width; x++)
+			pixels.push_back((uint8_t)c.getPixel(x, y));
+	if (c.exited)
+		pixels.push_back(c.halted ? 2 : 1);
+	return xxhash64(pixels.data(), pixels.size());
+}
+
+static std::string hex(uint64_t value)
+{
+	std::string text(16, '0');
+	for (int i = 15; i >= 0; i--, value >>= 4)
+		text[i] = "0123456789abcdef"[value & 0xF];
+	return text;
+}
+
+/*
+ * Golden file: a line per checkpoint, "<frame> <hash> <ROM name>"
+*/
+static bool readGolden(const char* path, std::map<std::string, std::map<int, std::string>>& golden)
+{
+	std::ifstream in(path);
+	if (!in)
+		return false;
+	std::string line;
+	while (std::getline(in, line))
+	{
+		std::istringstream fields(line);
+		int frame;
+		std::string hash, name;
+		if (!(fields >> frame >> hash) || !std::getline(fields >> std::ws, name))
+			continue;
+		golden[name][frame] = hash;
+	}
+	return true;
+}
+
+int main(int argc, char* args[])
+{
+	int frames = 600; // 10 seconds at 60 Hz
+	int every = 30; // Frames between two checkpoints
+	int threads = (int)std::thread::hardware_concurrency();
+	const char* goldenPath = "golden.txt";
+	bool update = false;
+	bool usage = false;
+	std::vector<const char*> inputs;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(args[i], "--frames") == 0 && i + 1 < argc)
+			frames = atoi(args[++i]);
+		else if (strcmp(args[i], "--every") == 0 && i + 1 < argc)
+			every = atoi(args[++i]);
+		else if (strcmp(args[i], "--threads") == 0 && i + 1 < argc)
+			threads = atoi(args[++i]);
+		else if (strcmp(args[i], "--golden") == 0 && i + 1 < argc)
+			goldenPath = args[++i];
+		else if (strcmp(args[i], "--update") == 0)
+			update = true;
+		else if (args[i][0] == '-')
+			usage = true; // Not taken for a ROM
+		else
+			inputs.push_back(args[i]);
+	}
+	if (usage || frames < 1 || every < 1)
+	{
+		std::cout << "Usage: chip8-golden [--frames N] [--every N] [--threads N] [--golden file] [--update] [ROM pack, ROM or directory]..."
+			<< std::endl;
+		return 1;
+	}
+	if (inputs.empty())
+		inputs.push_back("../roms");
+	if (threads < 1)
+		threads = 1;
+
+	// Every file of a directory, in name order so the golden file stays sorted
+	std::vector<std::string> paths;
+	for (const char* input : inputs)
+	{
+		std::error_code error;
+		if (!std::filesystem::is_directory(input, error))
+		{
+			paths.push_back(input);
+			continue;
+		}
+		size_t first = paths.size();
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(input, error))
+			if (entry.is_regular_file(error))
+				paths.push_back(entry.path().string());
+		std::sort(paths.begin() + first, paths.end());
+	}
+
+	std::vector<std::unique_ptr<RomPack>> packs;
+	std::vector<std::unique_ptr<MappedFile>> files;
+	std::vector<Rom> roms;
+	int unopened = 0;
+	for (const std::string& path : paths)
+	{
+		std::unique_ptr<RomPack> pack(new RomPack());
+		if (pack->open(path.c_str()))
+		{
+			for (uint32_t i = 0; i < pack->size(); i++)
+				roms.push_back({ std::string(pack->at(i).name), pack->at(i).image, {} });
+			packs.push_back(std::move(pack));
+			continue;
+		}
+
+		std::unique_ptr<MappedFile> file(new MappedFile());
+		if (!file->open(path.c_str()))
+		{
+			std::cout << "Can't open " << path << std::endl;
+			unopened++;
+			continue;
+		}
+		roms.push_back({ std::filesystem::path(path).filename().string(), file->bytes(), {} });
+		files.push_back(std::move(file));
+	}
+
+	if (roms.empty())
+	{
+		std::cout << "No ROMs to run, run from chip8-golden/ or give the ROMs" << std::endl;
+		return 1;
+	}
+
+	// The programs that stop on unknown opcodes are compared like the others
+	LogSink::global().setEnabled(false);
+
+	// Each thread takes the next ROM until there are none left
+	std::atomic<size_t> next(0);
+	auto worker = [&]()
+	{
+		for (size_t r = next++; r < roms.size(); r = next++)
+		{
+			Rom& rom = roms[r];
+			Chip8 chip8;
+			chip8.initialize();
+			if (!chip8.loadProgram(rom.image))
+				continue;
+			rom.loaded = true;
+
+			int cyclesPerFrame = chip8.romInfo->cyclesPerFrame;
+			for (int f = 1; f <= frames; f++)
+			{
+				pressKeys(chip8, f - 1);
+				chip8.run(cyclesPerFrame);
+				if (f % every == 0)
+					rom.hashes.push_back(screenHash(chip8));
+			}
+		}
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> pool;
+	for (int t = 0; t < threads; t++)
+		pool.emplace_back(worker);
+	for (std::thread& t : pool)
+		t.join();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if (update)
+	{
+		if (unopened)
+		{
+			std::cout << "Not writing " << goldenPath << ", " << unopened << " inputs can't be opened" << std::endl;
+			return 1;
+		}
+		std::ofstream out(goldenPath);
+		for (const Rom& rom : roms)
+			for (size_t i = 0; i < rom.hashes.size(); i++)
+				out << (i + 1) * every << " " << hex(rom.hashes[i]) << " " << rom.name << "\n";
+		out.close();
+		if (out.fail())
+		{
+			std::cout << "Can't write " << goldenPath << std::endl;
+			return 1;
+		}
+		std::cout << "Wrote the golden hashes of " << roms.size() << " ROMs to " << goldenPath << std::endl;
+		return 0;
+	}
+
+	std::map<std::string, std::map<int, std::string>> golden;
+	if (!readGolden(goldenPath, golden))
+	{
+		std::cout << "Can't read " << goldenPath << ", write it with --update" << std::endl;
+		return 1;
+	}
+
+	// Report the first checkpoint that differs, the later ones usually follow from it
+	int failed = unopened, checked = 0;
+	for (const Rom& rom : roms)
+	{
+		if (!rom.loaded)
+		{
+			std::cout << rom.name << ": not loaded" << std::endl;
+			failed++;
+			continue;
+		}
+		auto expected = golden.find(rom.name);
+		if (expected == golden.end())
+		{
+			std::cout << rom.name << ": no golden hashes" << std::endl;
+			failed++;
+			continue;
+		}
+		for (size_t i = 0; i < rom.hashes.size(); i++)
+		{
+			int frame = (int)(i + 1) * every;
+			auto hash = expected->second.find(frame);
+			if (hash == expected->second.end())
+				continue; // Checkpoint past the golden run
+			checked++;
+			if (hash->second != hex(rom.hashes[i]))
+			{
+				std::cout << rom.name << ": frame " << frame << " differs (expected " << hash->second << ", got "
+					<< hex(rom.hashes[i]) << ")" << std::endl;
+				failed++;
+				break;
+			}
+		}
+	}
+
+	// The golden ROMs that weren't run aren't checked, e.g. after a rename
+	size_t total = roms.size() + unopened;
+	for (const auto& entry : golden)
+		if (std::none_of(roms.begin(), roms.end(), [&](const Rom& rom) { return rom.name == entry.first; }))
+		{
+			std::cout << entry.first << ": in " << goldenPath << " but not run" << std::endl;
+			failed++;
+			total++;
+		}
+
+	std::cout << total - failed << " of " << total << " ROMs match, " << checked << " checkpoints in "
+		<< (int)(seconds * 1000) << " ms" << std::endl;
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,375 @@
+// chip8-lockstep: runs the interpreters side by side with the reference one and reports where they diverge
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Chip8.h"
+#include "Debugger.h"
+#include "Disassembler.h"
+#include "Hash.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "Profiler.h"
+#include "RomPack.h"
+#include "Tracer.h"
+
+#define KEY_PERIOD 32 // Frames between two key presses of the input script
+#define KEY_FRAMES 8 // Frames a key is held
+#define DIFF_LINES 8 // Differing memory bytes and framebuffer words listed
+
+/*
+ * Interpreter checked against the reference. The hooks keep state between runs (e.g. the debugger pauses
+ * when the program exits), so a new one runs each ROM.
+*/
+class Runner
+{
+public:
+	virtual ~Runner() = default;
+	virtual void run(Chip8& c, int cycles) = 0;
+};
+
+// Chip8::run(): the interpreter of the platform, with the idle skip
+class PlainRunner : public Runner
+{
+public:
+	void run(Chip8& c, int cycles) override { c.run(cycles); }
+};
+
+// Interpreters specialized for hooks (see Hooks.h)
+template <class H>
+class HooksRunner : public Runner
+{
+public:
+	void run(Chip8& c, int cycles) override { hooks.run(c, cycles); }
+
+private:
+	H hooks;
+};
+
+struct Backend
+{
+	const char* name;
+	const char* description;
+	std::unique_ptr<Runner>(*make)();
+};
+
+/*
+ * Every interpreter of the tree, a new one is added here to be checked
+*/
+static const Backend backends[] =
+{
+	{ "run", "Chip8::run(), a frame per call", [] { return std::unique_ptr<Runner>(new PlainRunner()); } },
+	{ "tracer", "Tracer::run()", [] { return std::unique_ptr<Runner>(new HooksRunner<Tracer>()); } },
+	{ "profiler", "Profiler::run()", [] { return std::unique_ptr<Runner>(new HooksRunner<Profiler>()); } },
+	{ "debugger", "Debugger::run() without breakpoints", [] { return std::unique_ptr<Runner>(new HooksRunner<Debugger>()); } }
+};
+
+struct Rom
+{
+	std::string name;
+	std::span<const uint8_t> image;
+	uint64_t instructions = 0; // Checked
+	std::string report; // How the backend diverged, empty if it didn't
+};
+
+/*
+ * Scripted input: each key in turn is held a few frames, the same as chip8-bench and chip8-golden
+*/
+static void pressKeys(Chip8& c, int frame)
+{
+	memset(c.key, 0, sizeof(c.key));
+	if (frame % KEY_PERIOD < KEY_FRAMES)
+		c.key[(frame / KEY_PERIOD) & 0xF] = 1;
+}
+
+/*
+ * Hash of everything an interpreter changes: the fingerprint and the outputs it leaves out.
+ * The idle cycles are left out, they count how a backend got there.
+*/
+static uint64_t stateHash(const Chip8& c)
+{
+	struct
+	{
+		int playSound;
+		bool drawFlag;
+	} outputs;
+	memset(&outputs, 0, sizeof(outputs));
+	outputs.playSound = c.playSound;
+	outputs.drawFlag = c.drawFlag;
+	return xxhash64(&outputs, sizeof(outputs), c.fingerprint());
+}
+
+static std::string hex(unsigned int value, int digits)
+{
+	std::string text(digits, '0');
+	for (int i = digits - 1; i >= 0; i--, value >>= 4)
+		text[i] = "0123456789ABCDEF"[value & 0xF];
+	return text;
+}
+
+/*
+ * Fields of the reference and of the backend that differ
+*/
+static void diffStates(const Chip8& ref, const Chip8& other, std::ostream& out)
+{
+	auto field = [&](const std::string& name, unsigned int a, unsigned int b, int digits)
+	{
+		if (a != b)
+			out << "    " << name << ": " << hex(a, digits) << " != " << hex(b, digits) << "\n";
+	};
+	for (int i = 0; i < V_LENGTH; i++)
+		field("V" + hex(i, 1), ref.V[i], other.V[i], 2);
+	field("I", ref.I, other.I, 4);
+	field("pc", ref.pc, other.pc, 4);
+	field("sp", ref.sp, other.sp, 2);
+	for (int i = 0; i < STACK_LENGTH; i++)
+		field("stack[" + std::to_string(i) + "]", ref.stack[i], other.stack[i], 4);
+	field("delay timer", ref.delay_timer, other.delay_timer, 2);
+	field("sound timer", ref.sound_timer, other.sound_timer, 2);
+	field("playSound", (unsigned int)ref.playSound, (unsigned int)other.playSound, 8);
+	field("random", ref.random, other.random, 8);
+	field("hires", ref.hires, other.hires, 1);
+	field("planes", ref.planes, other.planes, 1);
+	field("exited", ref.exited, other.exited, 1);
+	field("halted", ref.halted, other.halted, 1);
+	field("drawFlag", ref.drawFlag, other.drawFlag, 1);
+	field("pitch", ref.pitch, other.pitch, 2);
+	for (int i = 0; i < RPL_LENGTH; i++)
+		field("rpl[" + std::to_string(i) + "]", ref.rpl[i], other.rpl[i], 2);
+	for (int i = 0; i < AUDIO_PATTERN_LENGTH; i++)
+		field("audioPattern[" + std::to_string(i) + "]", ref.audioPattern[i], other.audioPattern[i], 2);
+
+	int differing = 0;
+	for (unsigned int addr = 0; addr < ref.memSize; addr++)
+		if (ref.read(addr) != other.read(addr) && differing++ < DIFF_LINES)
+			field("memory[" + hex(addr, 4) + "]", ref.read(addr), other.read(addr), 2);
+	if (differing > DIFF_LINES)
+		out << "    ... " << differing << " memory bytes differ\n";
+
+	differing = 0;
+	for (int p = 0; p < PLANES; p++)
+		for (int y = 0; y < HIRES_HEIGHT; y++)
+			for (int w = 0; w < ROW_WORDS; w++)
+				if (ref.gfx[p][y][w] != other.gfx[p][y][w] && differing++ < DIFF_LINES)
+					out << "    plane " << p << " row " << y << " word " << w << ": " << hex((unsigned int)(ref.gfx[p][y][w] >> 32), 8)
+						<< hex((unsigned int)ref.gfx[p][y][w], 8) << " != " << hex((unsigned int)(other.gfx[p][y][w] >> 32), 8)
+						<< hex((unsigned int)other.gfx[p][y][w], 8) << "\n";
+	if (differing > DIFF_LINES)
+		out << "    ... " << differing << " framebuffer words differ\n";
+}
+
+/*
+ * Find the first instruction after the checkpoint where the backend diverges. The backend is run from
+ * the checkpoint again for each prefix, with the same calls as in the checked run (whole frames, then
+ * the cycles of the prefix), since it may behave differently for one cycle than for a frame.
+*/
+static std::string findDivergence(Chip8& checkpoint, int firstFrame, int frames, int cyclesPerFrame, uint64_t firstCycle,
+	const Backend& backend)
+{
+	std::ostringstream out;
+	Chip8 ref, other;
+	checkpoint.cloneInto(ref);
+	for (int f = 0; f < frames; f++)
+	{
+		pressKeys(ref, firstFrame + f);
+		for (int k = 1; k <= cyclesPerFrame; k++)
+		{
+			unsigned short pc = ref.pc;
+			unsigned short opcode = (unsigned short)(ref.read(pc) << 8 | ref.read(pc + 1));
+			ref.emulateCycle();
+
+			checkpoint.cloneInto(other);
+			std::unique_ptr<Runner> runner = backend.make();
+			for (int g = 0; g < f; g++)
+			{
+				pressKeys(other, firstFrame + g);
+				runner->run(other, cyclesPerFrame);
+			}
+			pressKeys(other, firstFrame + f);
+			runner->run(other, k);
+
+			if (stateHash(ref) != stateHash(other))
+			{
+				out << "diverged at instruction " << firstCycle + (uint64_t)f * cyclesPerFrame + k - 1 << " (frame "
+					<< firstFrame + f << "), " << hex(pc, 4) << ": " << hex(opcode, 4) << " " << disassemble(opcode, ref.platform)
+					<< "\n  reference != backend:\n";
+				diffStates(ref, other, out);
+				return out.str();
+			}
+		}
+	}
+	out << "diverged in frames " << firstFrame << " to " << firstFrame + frames - 1
+		<< " but not when run again from the checkpoint\n";
+	return out.str();
+}
+
+int main(int argc, char* args[])
+{
+	int frames = 3600; // A minute at 60 Hz
+	int every = 1; // Frames between two comparisons
+	int threads = (int)std::thread::hardware_concurrency();
+	std::vector<const char*> names;
+	std::vector<const char*> inputs;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(args[i], "--frames") == 0 && i + 1 < argc)
+			frames = atoi(args[++i]);
+		else if (strcmp(args[i], "--every") == 0 && i + 1 < argc)
+			every = atoi(args[++i]);
+		else if (strcmp(args[i], "--threads") == 0 && i + 1 < argc)
+			threads = atoi(args[++i]);
+		else if (strcmp(args[i], "--backend") == 0 && i + 1 < argc)
+			names.push_back(args[++i]);
+		else
+			inputs.push_back(args[i]);
+	}
+	if (inputs.empty() || frames < 1 || every < 1)
+	{
+		std::cout << "Usage: chip8-lockstep [--backend name]... [--frames N] [--every N] [--threads N] <ROM pack, ROM or directory>..."
+			<< std::endl << "Backends, all by default:" << std::endl;
+		for (const Backend& backend : backends)
+			std::cout << "  " << backend.name << "\t" << backend.description << std::endl;
+		return 1;
+	}
+	if (threads < 1)
+		threads = 1;
+
+	std::vector<const Backend*> checked;
+	for (const Backend& backend : backends)
+		if (names.empty() || std::any_of(names.begin(), names.end(), [&](const char* name) { return strcmp(name, backend.name) == 0; }))
+			checked.push_back(&backend);
+	if (checked.size() < std::max<size_t>(names.size(), 1))
+	{
+		std::cout << "Unknown backend, run without arguments for the list" << std::endl;
+		return 1;
+	}
+
+	// Every file of a directory, in name order
+	std::vector<std::string> paths;
+	for (const char* input : inputs)
+	{
+		std::error_code error;
+		if (!std::filesystem::is_directory(input, error))
+		{
+			paths.push_back(input);
+			continue;
+		}
+		size_t first = paths.size();
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(input, error))
+			if (entry.is_regular_file(error))
+				paths.push_back(entry.path().string());
+		std::sort(paths.begin() + first, paths.end());
+	}
+
+	std::vector<std::unique_ptr<RomPack>> packs;
+	std::vector<std::unique_ptr<MappedFile>> files;
+	std::vector<Rom> roms;
+	for (const std::string& path : paths)
+	{
+		std::unique_ptr<RomPack> pack(new RomPack());
+		if (pack->open(path.c_str()))
+		{
+			for (uint32_t i = 0; i < pack->size(); i++)
+				roms.push_back({ std::string(pack->at(i).name), pack->at(i).image, 0, {} });
+			packs.push_back(std::move(pack));
+			continue;
+		}
+
+		std::unique_ptr<MappedFile> file(new MappedFile());
+		if (!file->open(path.c_str()))
+		{
+			std::cout << "Can't open " << path << std::endl;
+			continue;
+		}
+		roms.push_back({ std::filesystem::path(path).filename().string(), file->bytes(), 0, {} });
+		files.push_back(std::move(file));
+	}
+	LogSink::global().setEnabled(false);
+
+	int failed = 0;
+	for (const Backend* backend : checked)
+	{
+		for (Rom& rom : roms)
+		{
+			rom.instructions = 0;
+			rom.report.clear();
+		}
+
+		// Each thread takes the next ROM until there are none left
+		std::atomic<size_t> next(0);
+		auto worker = [&]()
+		{
+			Chip8 ref, other, checkpoint;
+			for (size_t r = next++; r < roms.size(); r = next++)
+			{
+				Rom& rom = roms[r];
+				std::unique_ptr<Runner> runner = backend->make();
+				ref.initialize();
+				if (!ref.loadProgram(rom.image))
+				{
+					rom.report = "not loaded\n";
+					continue;
+				}
+				ref.cloneInto(other);
+				ref.cloneInto(checkpoint);
+
+				int cyclesPerFrame = ref.romInfo->cyclesPerFrame;
+				int checkpointFrame = 0;
+				for (int f = 0; f < frames; f++)
+				{
+					pressKeys(ref, f);
+					for (int i = 0; i < cyclesPerFrame; i++)
+						ref.emulateCycle();
+					pressKeys(other, f);
+					runner->run(other, cyclesPerFrame);
+					rom.instructions += cyclesPerFrame;
+
+					if ((f + 1) % every != 0 && f + 1 != frames)
+						continue;
+					if (stateHash(ref) != stateHash(other))
+					{
+						rom.report = findDivergence(checkpoint, checkpointFrame, f + 1 - checkpointFrame, cyclesPerFrame,
+							(uint64_t)checkpointFrame * cyclesPerFrame, *backend);
+						break;
+					}
+					ref.cloneInto(checkpoint);
+					checkpointFrame = f + 1;
+				}
+			}
+		};
+
+		auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> pool;
+		for (int t = 0; t < threads; t++)
+			pool.emplace_back(worker);
+		for (std::thread& t : pool)
+			t.join();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		uint64_t instructions = 0;
+		int diverged = 0;
+		for (const Rom& rom : roms)
+		{
+			instructions += rom.instructions;
+			if (!rom.report.empty())
+			{
+				std::cout << backend->name << ", " << rom.name << ": " << rom.report;
+				diverged++;
+			}
+		}
+		std::cout << backend->name << ": " << roms.size() - diverged << " of " << roms.size() << " ROMs in lockstep, "
+			<< instructions << " instructions in " << (int)(seconds * 1000) << " ms ("
+			<< (uint64_t)(instructions / seconds / 1e6) << " M/s)" << std::endl;
+		failed += diverged;
+	}
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,244 @@
+// chip8-opbench: cost of each opcode family of the interpreter, with the hardware counters of the CPU on Linux
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Chip8.h"
+#include "Log.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define REPEATS 5 // Best of, to filter out the noise of other processes
+#define KERNEL_REPEAT 32 // Copies of the kernel between two jumps back, so the jump costs little
+#define WARMUP 100000 // Instructions run before measuring, to fill the caches and the predictors
+
+/*
+ * Hardware counters of the CPU
+*/
+enum Counter
+{
+	Cycles,
+	Instructions,
+	Branches,
+	BranchMisses,
+	L1dMisses,
+	COUNTERS
+};
+
+/*
+ * Counters of the calling thread, read with perf_event_open on Linux.
+ * They are opened as a group so they all count the same instructions. A counter the CPU or the kernel
+ * doesn't have (virtual machines, perf_event_paranoid) is left out and reads as unavailable.
+*/
+class PerfCounters
+{
+public:
+	PerfCounters()
+	{
+#ifdef __linux__
+		static const struct { uint32_t type; uint64_t config; } events[COUNTERS] = {
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+			{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16 }
+		};
+		for (int i = 0; i < COUNTERS; i++)
+		{
+			perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = events[i].type;
+			attr.config = events[i].config;
+			attr.disabled = leader < 0; // The group is enabled through its leader
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.read_format = PERF_FORMAT_GROUP;
+			int fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+			if (fd < 0)
+				continue;
+			if (leader < 0)
+				leader = fd;
+			fds.push_back(fd);
+			order[i] = (int)fds.size() - 1;
+		}
+#endif
+	}
+
+	~PerfCounters()
+	{
+#ifdef __linux__
+		for (int fd : fds)
+			close(fd);
+#endif
+	}
+
+	bool has(Counter counter) const { return order[counter] >= 0; }
+
+	void start()
+	{
+#ifdef __linux__
+		if (leader >= 0)
+		{
+			ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+			ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+		}
+#endif
+	}
+
+	void stop()
+	{
+#ifdef __linux__
+		if (leader < 0)
+			return;
+		ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+		// Number of counters, then their values in the order they were opened
+		uint64_t group[1 + COUNTERS] = {};
+		if (read(leader, group, sizeof(group)) < (ssize_t)sizeof(uint64_t))
+			return;
+		for (int i = 0; i < COUNTERS; i++)
+			if (order[i] >= 0 && (uint64_t)order[i] < group[0])
+				values[i] = group[1 + order[i]];
+#endif
+	}
+
+	uint64_t values[COUNTERS] = {};
+
+private:
+	int leader = -1;
+	std::vector<int> fds;
+	int order[COUNTERS] = { -1, -1, -1, -1, -1 }; // Position of each counter in the group
+};
+
+/*
+ * Program repeating one opcode family: the prologue sets up the registers, then the body is repeated
+ * and jumped back to forever
+*/
+struct Kernel
+{
+	std::string name;
+	std::vector<uint16_t> prologue;
+	std::vector<uint16_t> body;
+};
+
+static std::vector<Kernel> kernels()
+{
+	std::vector<Kernel> list = {
+		{ "00E0", {}, { 0x00E0 } },
+		{ "8XYN ALU", { 0x6001, 0x6103, 0x6207, 0x630F }, { 0x8014, 0x8125, 0x8231, 0x8302, 0x8013, 0x8126, 0x820E, 0x8310 } },
+		{ "Skips taken", { 0x6000 }, { 0x3000, 0x6100, 0x4001, 0x6100 } }, // Always skip the load
+		{ "Skips 50/50", { 0x6000, 0x619D }, { 0x8014, 0x3F00, 0x6200 } }, // Skip on the carry of V0 += 0x9D
+	};
+	for (uint16_t x = 0; x < 8; x++) // The sprite straddles two bytes of a row unless X is a multiple of 8
+		list.push_back({ "DXYN X%8=" + std::to_string(x), { (uint16_t)(0x6000 | x), 0x6100, 0xA000 }, { 0xD015 } });
+	list.push_back({ "FX33", { 0xA300, 0x60AB }, { 0xF033 } });
+	list.push_back({ "FX55", { 0xA300 }, { 0xFF55 } });
+	list.push_back({ "FX65", { 0xA300 }, { 0xFF65 } });
+	return list;
+}
+
+/*
+ * ROM of a kernel, big endian opcodes
+*/
+static std::vector<uint8_t> assemble(const Kernel& kernel)
+{
+	std::vector<uint16_t> opcodes = kernel.prologue;
+	uint16_t loop = (uint16_t)(0x200 + 2 * opcodes.size());
+	for (int i = 0; i < KERNEL_REPEAT; i++)
+		opcodes.insert(opcodes.end(), kernel.body.begin(), kernel.body.end());
+	opcodes.push_back(0x1000 | loop);
+
+	std::vector<uint8_t> rom;
+	for (uint16_t opcode : opcodes)
+	{
+		rom.push_back((uint8_t)(opcode >> 8));
+		rom.push_back((uint8_t)opcode);
+	}
+	return rom;
+}
+
+/*
+ * Fixed width column of the table
+*/
+static std::string column(const std::string& text, size_t width)
+{
+	return text.size() < width ? text + std::string(width - text.size(), ' ') : text + " ";
+}
+
+static std::string number(double value, int decimals)
+{
+	std::string text = std::to_string(value);
+	return text.substr(0, text.find('.') + (decimals ? decimals + 1 : 0));
+}
+
+int main(int argc, char* args[])
+{
+	int cycles = 10000000;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(args[i], "--cycles") == 0 && i + 1 < argc)
+			cycles = atoi(args[++i]);
+		else
+		{
+			std::cout << "Usage: chip8-opbench [--cycles N]" << std::endl;
+			return 1;
+		}
+	}
+
+	PerfCounters counters;
+	if (!counters.has(Cycles))
+		std::cout << "No hardware counters (perf_event_open), only the times are measured" << std::endl;
+	LogSink::global().setEnabled(false);
+
+	std::cout << "Opcodes        ns/op   cycles/op  instr/op   IPC    branch miss  L1D miss/op" << std::endl;
+	for (const Kernel& kernel : kernels())
+	{
+		std::vector<uint8_t> rom = assemble(kernel);
+		double bestSeconds = 0;
+		uint64_t best[COUNTERS] = {};
+		for (int r = 0; r < REPEATS; r++)
+		{
+			Chip8 chip8;
+			chip8.initialize();
+			chip8.loadProgram(rom);
+			chip8.run(WARMUP);
+
+			counters.start();
+			auto start = std::chrono::steady_clock::now();
+			chip8.run(cycles);
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			counters.stop();
+
+			if (r == 0 || seconds < bestSeconds)
+			{
+				bestSeconds = seconds;
+				memcpy(best, counters.values, sizeof(best));
+			}
+		}
+
+		auto perOp = [&](Counter counter, int decimals)
+		{
+			return counters.has(counter) ? number((double)best[counter] / cycles, decimals) : std::string("n/a");
+		};
+		std::string ipc = "n/a", misses = "n/a";
+		if (counters.has(Cycles) && counters.has(Instructions) && best[Cycles])
+			ipc = number((double)best[Instructions] / best[Cycles], 2);
+		if (counters.has(Branches) && counters.has(BranchMisses) && best[Branches])
+			misses = number(100.0 * best[BranchMisses] / best[Branches], 2) + "%";
+
+		std::cout << column(kernel.name, 15) << column(number(bestSeconds * 1e9 / cycles, 2), 8)
+			<< column(perOp(Cycles, 1), 11) << column(perOp(Instructions, 1), 10) << column(ipc, 7)
+			<< column(misses, 13) << perOp(L1dMisses, 3) << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,97 @@
+// chip8-pack: builds and lists ROM pack archives (see RomPack.h)
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "RomPack.h"
+#include "RomDatabase.h"
+
+namespace fs = std::filesystem;
+
+typedef std::vector<std::pair<std::string, std::vector<uint8_t>>> RomList;
+
+// Read a ROM into the list with the given name
+static bool addRom(RomList& roms, const fs::path& path, const std::string& name)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+	{
+		std::cout << "Can't open " << path.string() << std::endl;
+		return false;
+	}
+	std::vector<uint8_t> image((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	roms.emplace_back(name, std::move(image));
+	return true;
+}
+
+static int list(const char* archive)
+{
+	RomPack pack;
+	if (!pack.open(archive))
+	{
+		std::cout << "Invalid ROM pack " << archive << std::endl;
+		return 1;
+	}
+
+	for (uint32_t i = 0; i < pack.size(); i++)
+	{
+		RomPack::Rom rom = pack.at(i);
+		const RomInfo& info = findRom(rom.hash);
+		std::cout << std::hex;
+		std::cout.width(16);
+		std::cout.fill('0');
+		std::cout << rom.hash << std::dec << " " << rom.image.size() << "\t" << rom.name;
+		if (info.name != nullptr)
+			std::cout << " (" << info.name << ")";
+		std::cout << std::endl;
+	}
+	std::cout << pack.size() << " ROMs" << std::endl;
+	return 0;
+}
+
+int main(int argc, char* args[])
+{
+	if (argc == 3 && strcmp(args[1], "-l") == 0)
+		return list(args[2]);
+
+	if (argc < 3)
+	{
+		std::cout << "Usage: chip8-pack <archive> <ROM or directory>..." << std::endl;
+		std::cout << "       chip8-pack -l <archive>" << std::endl;
+		return 1;
+	}
+
+	// Files are named by their path relative to the directory given, or by their file name
+	RomList roms;
+	for (int i = 2; i < argc; i++)
+	{
+		fs::path path = args[i];
+		std::error_code ec;
+		if (fs::is_directory(path, ec))
+		{
+			for (const fs::directory_entry& entry : fs::recursive_directory_iterator(path, ec))
+			{
+				if (entry.is_regular_file() && !addRom(roms, entry.path(), entry.path().lexically_relative(path).generic_string()))
+					return 1;
+			}
+		}
+		else if (!addRom(roms, path, path.filename().generic_string()))
+			return 1;
+	}
+
+	// Names are the lookup key, keep the first of any duplicate
+	std::stable_sort(roms.begin(), roms.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+	roms.erase(std::unique(roms.begin(), roms.end(), [](const auto& a, const auto& b) { return a.first == b.first; }), roms.end());
+
+	if (!RomPack::build(args[1], roms))
+	{
+		std::cout << "Can't write " << args[1] << std::endl;
+		return 1;
+	}
+	std::cout << "Packed " << roms.size() << " ROMs into " << args[1] << std::endl;
+	return 0;
+}
@@ -0,0 +1,87 @@
+// chip8-trace: prints the instructions of a trace written by the emulator (see Tracer.h)
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include "Disassembler.h"
+#include "MappedFile.h"
+#include "RomDatabase.h"
+#include "Tracer.h"
+
+static const char* const reasons[] = { "on request", "on the trigger", "on an unknown opcode", "on a crash" };
+
+/*
+ * Hexadecimal number with a fixed number of digits, without touching the format flags of std::cout
+*/
+static std::string hex(unsigned int value, int digits)
+{
+	std::string text(digits, '0');
+	for (int i = digits - 1; i >= 0; i--, value >>= 4)
+		text[i] = "0123456789ABCDEF"[value & 0xF];
+	return text;
+}
+
+int main(int argc, char* args[])
+{
+	unsigned int last = 0; // Only print the last instructions, 0 for all
+	const char* path = nullptr;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(args[i], "--last") == 0 && i + 1 < argc)
+			last = (unsigned int)atoi(args[++i]);
+		else
+			path = args[i];
+	}
+	if (!path)
+	{
+		std::cout << "Usage: chip8-trace [--last N] <trace>" << std::endl;
+		return 1;
+	}
+
+	MappedFile file;
+	if (!file.open(path))
+	{
+		std::cout << "Can't open " << path << std::endl;
+		return 1;
+	}
+
+	std::span<const uint8_t> bytes = file.bytes();
+	TraceHeader header;
+	if (bytes.size() < sizeof(header))
+	{
+		std::cout << path << " is not a trace" << std::endl;
+		return 1;
+	}
+	memcpy(&header, bytes.data(), sizeof(header));
+	if (memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 || header.version != TRACE_VERSION
+		|| header.platform > (uint32_t)Platform::XoChip || header.reason > (uint32_t)TraceReason::Crash
+		|| sizeof(header) + (uint64_t)header.count * sizeof(TraceRecord) > bytes.size())
+	{
+		std::cout << path << " is not a trace" << std::endl;
+		return 1;
+	}
+
+	Platform platform = (Platform)header.platform;
+	const RomInfo& info = findRom(header.romHash);
+	std::cout << (info.name ? info.name : "Unknown ROM") << " (" << withPlatform(platform, [](auto p) { return p.name; })
+		<< "), " << header.count << " instructions, written " << reasons[header.reason] << std::endl;
+	std::cout << "Cycle         PC    Opcode  Instruction            I     VX    VF" << std::endl;
+
+	uint32_t first = last && last < header.count ? header.count - last : 0;
+	for (uint32_t i = first; i < header.count; i++)
+	{
+		TraceRecord r;
+		memcpy(&r, bytes.data() + sizeof(header) + i * sizeof(TraceRecord), sizeof(r));
+
+		std::string cycle = std::to_string(header.firstCycle + i);
+		std::string instruction = disassemble(r.opcode, platform);
+		cycle.resize(std::max<size_t>(cycle.size(), 12), ' ');
+		instruction.resize(std::max<size_t>(instruction.size(), 22), ' ');
+		std::cout << cycle << "  " << hex(r.pc, 4) << "  " << hex(r.opcode, 4) << "    " << instruction
+			<< " " << hex(r.I, 4) << "  V" << hex((r.opcode >> 8) & 0xF, 1) << "=" << hex(r.vx, 2)
+			<< "  VF=" << hex(r.vf, 2) << "\n";
+	}
+	return 0;
+}